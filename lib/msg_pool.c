@@ -0,0 +1,161 @@
+#include "msg_pool.h"
+#include <stdint.h>
+
+
+/**
+ * @brief Create a pool whose slots can hold any message of a group
+ *
+ * @param[in] *group The group, the slot size is read via getMaxMessageSize()
+ * @param[in] slots The number of buffers of the pool
+ *
+ * @retval A pointer to the new pool
+ * @retval NULL on error
+ *
+ * @note If the maximum message size of the group is raised afterwards, longer
+ *          messages are rejected by readPooledMessage(): create a new pool
+ */
+msg_pool_t *createMessagePool(thread_group_t *group, const unsigned int slots){
+    msg_pool_t *pool;
+    unsigned long max_size;
+    size_t slot_size;
+    unsigned int i;
+
+    if(!group || slots == 0)
+        return NULL;
+
+    max_size = getMaxMessageSize(group);
+    if(max_size == 0)
+        return NULL;
+
+    //Every slot must hold the free list link and keep the next one aligned
+    slot_size = max_size < sizeof(void*) ? sizeof(void*) : max_size;
+    slot_size = (slot_size + MSG_POOL_ALIGN - 1) & ~((size_t)MSG_POOL_ALIGN - 1);
+
+    if(slot_size > SIZE_MAX / slots)
+        return NULL;
+
+    pool = (msg_pool_t*)malloc(sizeof(msg_pool_t));
+    if(!pool)
+        return NULL;
+
+    if(posix_memalign((void**)&pool->memory, MSG_POOL_ALIGN, slot_size * slots) != 0){
+        free(pool);
+        return NULL;
+    }
+
+    pool->slot_size = slot_size;
+    pool->slots = slots;
+    pool->available = slots;
+    pool->free_list = NULL;
+
+    //Thread the free list backwards, so slots are handed out in address order
+    for(i = slots; i > 0; i--){
+        *(void**)(pool->memory + (size_t)(i - 1) * slot_size) = pool->free_list;
+        pool->free_list = pool->memory + (size_t)(i - 1) * slot_size;
+    }
+
+    return pool;
+}
+
+/**
+ * @brief Destroy a pool, all its buffers become invalid
+ */
+void destroyMessagePool(msg_pool_t *pool){
+
+    if(!pool)
+        return;
+
+    free(pool->memory);
+    free(pool);
+}
+
+/**
+ * @brief Take a buffer of 'slot_size' bytes from a pool
+ *
+ * @retval A pointer to the buffer
+ * @retval NULL if all the buffers are in use
+ */
+void *poolGetBuffer(msg_pool_t *pool){
+    void *buffer;
+
+    if(!pool || !pool->free_list)
+        return NULL;
+
+    buffer = pool->free_list;
+    pool->free_list = *(void**)buffer;
+    pool->available--;
+
+    return buffer;
+}
+
+/**
+ * @brief Give back a buffer taken from the same pool
+ */
+void poolPutBuffer(msg_pool_t *pool, void *buffer){
+
+    if(!pool || !buffer)
+        return;
+
+    *(void**)buffer = pool->free_list;
+    pool->free_list = buffer;
+    pool->available++;
+}
+
+/**
+ * @brief Read a message into a buffer of a pool
+ *
+ * The size of the next message is checked before reading it, so a message
+ * that does not fit a slot is left in the group instead of being truncated.
+ *
+ * @param[in] *group An opened group
+ * @param[in] *pool A pool created for the group
+ * @param[out] *message On success 'buffer' is a buffer of the pool holding the
+ *              message, to be given back via poolPutBuffer(); 'size' and
+ *              'author' are set as by readMessages()
+ *
+ * @retval 0 on success
+ * @retval NO_MSG_PRESENT if no message is available
+ * @retval MSG_SIZE_ERROR if the next message is longer than 'slot_size'
+ * @retval ALLOC_ERR if all the buffers of the pool are in use
+ * @retval GROUP_CLOSED if the provided group is closed
+ * @retval -1 on error
+ *
+ * @note With modules that cannot report the size of the next message, the
+ *          message is read directly: it is truncated only if the maximum
+ *          message size was raised after the pool was created
+ */
+int readPooledMessage(thread_group_t *group, msg_pool_t *pool, msg_t *message){
+    size_t size;
+    void *buffer;
+    int ret;
+
+    if(!pool || !message)
+        return -1;
+
+    ret = nextMessageSize(group, &size);
+
+    if(ret == 0 && size > pool->slot_size)
+        return MSG_SIZE_ERROR;
+
+    if(ret != 0 && ret != UNSUPPORTED_ERR)
+        return ret;
+
+    buffer = poolGetBuffer(pool);
+    if(!buffer)
+        return ALLOC_ERR;
+
+    message->buffer = buffer;
+    message->size = pool->slot_size;
+
+    ret = readMessages(message, 1, group);
+
+    if(ret <= 0){
+        poolPutBuffer(pool, buffer);
+        message->buffer = NULL;
+        message->size = 0;
+
+        return ret == 0 ? NO_MSG_PRESENT : ret;
+    }
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file msg_pool.h
+ *
+ * @brief Pool of receive buffers sized for the messages of a group
+ *
+ * A pool carves a single allocation into slots as large as the group's maximum
+ * message size and keeps the free ones in a list threaded through the slots
+ * themselves. Messages read with readPooledMessage() are copied into a free
+ * slot: no allocation is done per message and no message is truncated.
+ */
+
+
+#ifndef MSG_POOL_H
+#define MSG_POOL_H
+
+
+#include "thread_synch.h"
+
+
+#define MSG_POOL_ALIGN      16      /**< Alignment of every slot */
+
+
+/**
+ * @brief Fixed-size receive buffers
+ *
+ * @note A pool is not thread-safe: threads reading concurrently should use a
+ *          pool each, or serialize the calls
+ */
+typedef struct T_MSG_POOL {
+    char *memory;               /**< Storage of all the slots */
+    size_t slot_size;           /**< Usable bytes of a slot, at least the maximum message size */
+    unsigned int slots;
+    unsigned int available;     /**< Slots in the free list */
+
+    void *free_list;            /**< First free slot, each one stores the next */
+} msg_pool_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+msg_pool_t *createMessagePool(thread_group_t *group, const unsigned int slots);
+void destroyMessagePool(msg_pool_t *pool);
+
+void *poolGetBuffer(msg_pool_t *pool);
+void poolPutBuffer(msg_pool_t *pool, void *buffer);
+
+int readPooledMessage(thread_group_t *group, msg_pool_t *pool, msg_t *message);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  //MSG_POOL_H
@@ -0,0 +1,456 @@
+#include "synch_reactor.h"
+#include <sys/eventfd.h>
+#include <errno.h>
+#include <stdint.h>
+
+
+static reactor_entry_t *_findEntry(synch_reactor_t *reactor, const thread_group_t *group){
+    reactor_entry_t *entry;
+
+    for(entry = reactor->entries; entry != NULL; entry = entry->next){
+        if(entry->group == group && !entry->removed)
+            return entry;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Request to epoll the events needed by a group: input if it has a
+ *          message callback, output only while writes are queued
+ */
+static int _updateEvents(synch_reactor_t *reactor, reactor_entry_t *entry){
+    struct epoll_event event;
+    uint32_t events = 0;
+
+    if(entry->on_message)
+        events |= EPOLLIN;
+    if(entry->write_head)
+        events |= EPOLLOUT;
+
+    if(events == entry->events)
+        return 0;
+
+    event.events = events;
+    event.data.ptr = entry;
+
+    if(epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, entry->group->file_descriptor, &event) < 0)
+        return -1;
+
+    entry->events = events;
+
+    return 0;
+}
+
+/**
+ * @brief Complete all the queued writes of a group with the given result
+ */
+static void _failWrites(reactor_entry_t *entry, const int result){
+    reactor_write_t *write;
+
+    while((write = entry->write_head) != NULL){
+        entry->write_head = write->next;
+
+        if(write->on_complete)
+            write->on_complete(entry->group, result, write->arg);
+
+        free(write);
+    }
+
+    entry->write_tail = NULL;
+}
+
+/**
+ * @brief Free the entries removed during an iteration
+ */
+static void _collectEntries(synch_reactor_t *reactor){
+    reactor_entry_t **cursor = &reactor->entries;
+    reactor_entry_t *entry;
+
+    while((entry = *cursor) != NULL){
+        if(entry->removed){
+            *cursor = entry->next;
+            free(entry);
+        }else
+            cursor = &entry->next;
+    }
+}
+
+/**
+ * @brief Enlarge the receive buffers to hold the next message of a group
+ *
+ * @retval 0 on success
+ * @retval -1 with 'errno' set to 'EMSGSIZE' if the buffers cannot be enlarged
+ */
+static int _growBuffer(synch_reactor_t *reactor, reactor_entry_t *entry){
+    size_t size;
+    char *buffer;
+
+    if(nextMessageSize(entry->group, &size) != 0 || size <= reactor->buffer_size)
+        goto fail;
+
+    if(size > SIZE_MAX / REACTOR_READ_BATCH)
+        goto fail;
+
+    buffer = (char*)realloc(reactor->buffer, size * REACTOR_READ_BATCH);
+    if(!buffer)
+        goto fail;
+
+    reactor->buffer = buffer;
+    reactor->buffer_size = size;
+
+    return 0;
+
+    fail:
+        errno = EMSGSIZE;
+        return -1;
+}
+
+/**
+ * @brief Read up to 'REACTOR_READ_BATCH' messages of a group with a single
+ *          syscall, one per receive buffer, and deliver them
+ *
+ * @retval 0 on success
+ * @retval -1 if a message longer than the buffers cannot be received
+ */
+static int _handleRead(synch_reactor_t *reactor, reactor_entry_t *entry){
+    msg_t messages[REACTOR_READ_BATCH];
+    int ret;
+    int i;
+
+    //A longer message is left in the group, retry with buffers that fit it
+    do{
+        for(i = 0; i < REACTOR_READ_BATCH; i++){
+            messages[i].buffer = reactor->buffer + (size_t)i * reactor->buffer_size;
+            messages[i].size = reactor->buffer_size;
+        }
+
+        ret = readMessages(messages, REACTOR_READ_BATCH, entry->group);
+    }while(ret == MSG_SIZE_ERROR && _growBuffer(reactor, entry) == 0);
+
+    if(ret == MSG_SIZE_ERROR)
+        return -1;
+
+    //No message left (or error): wait for the next readiness event
+    for(i = 0; i < ret && !entry->removed; i++)
+        entry->on_message(entry->group, messages[i].buffer, messages[i].size, entry->arg);
+
+    return 0;
+}
+
+static void _handleWrite(synch_reactor_t *reactor, reactor_entry_t *entry){
+    reactor_write_t *write;
+    int ret;
+    int i;
+
+    for(i = 0; i < REACTOR_WRITE_BATCH && !entry->removed && entry->write_head; i++){
+        write = entry->write_head;
+
+        entry->write_head = write->next;
+        if(!entry->write_head)
+            entry->write_tail = NULL;
+
+        ret = writeMessage(write->buffer, write->len, entry->group);
+
+        if(write->on_complete)
+            write->on_complete(entry->group, ret, write->arg);
+
+        free(write);
+    }
+
+    if(!entry->removed)
+        _updateEvents(reactor, entry);
+}
+
+
+/**
+ * @brief Create a reactor with no groups
+ *
+ * @param[in] buffer_size Initial size of each of the 'REACTOR_READ_BATCH'
+ *              receive buffers, 0 for 'REACTOR_BUFF_SIZE'. They grow to fit
+ *              longer messages
+ *
+ * @retval A pointer to the new reactor
+ * @retval NULL on error
+ */
+synch_reactor_t *createReactor(const size_t buffer_size){
+    synch_reactor_t *reactor;
+    struct epoll_event event;
+
+    reactor = (synch_reactor_t*)malloc(sizeof(synch_reactor_t));
+    if(!reactor)
+        return NULL;
+
+    reactor->entries = NULL;
+    reactor->stopped = false;
+    reactor->buffer_size = buffer_size > 0 ? buffer_size : REACTOR_BUFF_SIZE;
+
+    if(reactor->buffer_size > SIZE_MAX / REACTOR_READ_BATCH)
+        goto cleanup1;
+
+    reactor->buffer = (char*)malloc(reactor->buffer_size * REACTOR_READ_BATCH);
+    if(!reactor->buffer)
+        goto cleanup1;
+
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(reactor->epoll_fd < 0)
+        goto cleanup2;
+
+    reactor->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(reactor->wake_fd < 0)
+        goto cleanup3;
+
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;      //Identifies the wake-up eventfd
+
+    if(epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->wake_fd, &event) < 0)
+        goto cleanup4;
+
+    return reactor;
+
+    cleanup4:
+        close(reactor->wake_fd);
+    cleanup3:
+        close(reactor->epoll_fd);
+    cleanup2:
+        free(reactor->buffer);
+    cleanup1:
+        free(reactor);
+        return NULL;
+}
+
+/**
+ * @brief Destroy a reactor
+ *
+ * Queued writes are completed with 'GROUP_CLOSED'. The groups are neither
+ * closed nor deallocated, since they are owned by the caller
+ */
+void destroyReactor(synch_reactor_t *reactor){
+    reactor_entry_t *entry;
+
+    if(!reactor)
+        return;
+
+    for(entry = reactor->entries; entry != NULL; entry = entry->next){
+        entry->removed = true;
+        _failWrites(entry, GROUP_CLOSED);
+    }
+
+    _collectEntries(reactor);
+
+    close(reactor->wake_fd);
+    close(reactor->epoll_fd);
+    free(reactor->buffer);
+    free(reactor);
+}
+
+/**
+ * @brief Register an opened group on a reactor
+ *
+ * @param[in] *reactor The reactor
+ * @param[in] *group An opened group, not registered on the reactor
+ * @param[in] on_message Called for each message read from the group, NULL if
+ *              the group is used only for writing
+ * @param[in] *arg Passed to 'on_message'
+ *
+ * @retval 0 on success
+ * @retval GROUP_CLOSED if the provided group is closed
+ * @retval -1 on error
+ *
+ * @note Messages are read on behalf of the thread running the reactor, unless
+ *          the group was opened with openSharedGroup()
+ */
+int reactorAddGroup(synch_reactor_t *reactor, thread_group_t *group, reactor_msg_cb on_message, void *arg){
+    reactor_entry_t *entry;
+    struct epoll_event event;
+
+    if(!reactor || !group)
+        return -1;
+
+    if(group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    if(_findEntry(reactor, group))
+        return -1;
+
+    entry = (reactor_entry_t*)malloc(sizeof(reactor_entry_t));
+    if(!entry)
+        return -1;
+
+    entry->group = group;
+    entry->on_message = on_message;
+    entry->arg = arg;
+    entry->write_head = NULL;
+    entry->write_tail = NULL;
+    entry->events = on_message ? EPOLLIN : 0;
+    entry->removed = false;
+
+    event.events = entry->events;
+    event.data.ptr = entry;
+
+    if(epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, group->file_descriptor, &event) < 0){
+        free(entry);
+        return -1;
+    }
+
+    entry->next = reactor->entries;
+    reactor->entries = entry;
+
+    return 0;
+}
+
+/**
+ * @brief Remove a group from a reactor
+ *
+ * Queued writes of the group are completed with 'GROUP_CLOSED'. The function
+ * can be called from the callbacks, also for the group being served: the 
+ * rest of the batch being delivered is then discarded
+ *
+ * @retval 0 on success
+ * @retval -1 if the group is not registered
+ */
+int reactorRemoveGroup(synch_reactor_t *reactor, thread_group_t *group){
+    reactor_entry_t *entry;
+
+    if(!reactor || !(entry = _findEntry(reactor, group)))
+        return -1;
+
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, group->file_descriptor, NULL);
+
+    //Set first, so completion callbacks cannot queue new writes
+    entry->removed = true;
+    _failWrites(entry, GROUP_CLOSED);
+
+    return 0;
+}
+
+/**
+ * @brief Queue a write on a group registered on a reactor
+ *
+ * Writes of a group are issued in FIFO order when the reactor runs, and each
+ * one is completed through 'on_complete' with the result of writeMessage()
+ *
+ * @param[in] *buffer The message, it must stay valid until completion
+ *
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int reactorQueueWrite(synch_reactor_t *reactor, thread_group_t *group, const void *buffer, size_t len, reactor_write_cb on_complete, void *arg){
+    reactor_entry_t *entry;
+    reactor_write_t *write;
+
+    if(!reactor || !buffer || !(entry = _findEntry(reactor, group)))
+        return -1;
+
+    write = (reactor_write_t*)malloc(sizeof(reactor_write_t));
+    if(!write)
+        return -1;
+
+    write->buffer = buffer;
+    write->len = len;
+    write->on_complete = on_complete;
+    write->arg = arg;
+    write->next = NULL;
+
+    if(entry->write_tail)
+        entry->write_tail->next = write;
+    else
+        entry->write_head = write;
+
+    entry->write_tail = write;
+
+    if(_updateEvents(reactor, entry) < 0){
+        //Not reachable by the loop, complete it now
+        _failWrites(entry, -1);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Wait for events and serve the ready groups once
+ *
+ * @param[in] timeout Maximum wait in milliseconds, -1 to wait indefinitely
+ *
+ * @retval The number of served events
+ * @retval -1 on error, 'errno' is 'EMSGSIZE' if the receive buffer could not
+ *          grow to fit a message, which is left in its group
+ *
+ * @note Groups that are uninstalled are removed from the reactor
+ */
+int reactorRunOnce(synch_reactor_t *reactor, const int timeout){
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    reactor_entry_t *entry;
+    uint64_t counter;
+    int ready;
+    int ret = 0;
+    int i;
+
+    ready = epoll_wait(reactor->epoll_fd, events, REACTOR_MAX_EVENTS, timeout);
+
+    if(ready < 0)
+        return errno == EINTR ? 0 : -1;
+
+    for(i = 0; i < ready; i++){
+        entry = (reactor_entry_t*)events[i].data.ptr;
+
+        //Wake-up from reactorStop(), drain the eventfd
+        if(!entry){
+            if(read(reactor->wake_fd, &counter, sizeof(uint64_t)) < 0 && errno != EAGAIN)
+                return -1;
+            continue;
+        }
+
+        //Removed by a callback of a previous event
+        if(entry->removed)
+            continue;
+
+        if(events[i].events & (EPOLLERR | EPOLLHUP)){
+            reactorRemoveGroup(reactor, entry->group);
+            continue;
+        }
+
+        if((events[i].events & EPOLLIN) && _handleRead(reactor, entry) < 0)
+            ret = -1;
+
+        if(events[i].events & EPOLLOUT)
+            _handleWrite(reactor, entry);
+    }
+
+    _collectEntries(reactor);
+
+    return ret < 0 ? -1 : ready;
+}
+
+/**
+ * @brief Serve the registered groups until reactorStop() is called
+ *
+ * @retval 0 when stopped
+ * @retval -1 on error
+ */
+int reactorRun(synch_reactor_t *reactor){
+
+    while(!reactor->stopped){
+        if(reactorRunOnce(reactor, -1) < 0)
+            return -1;
+    }
+
+    reactor->stopped = false;
+
+    return 0;
+}
+
+/**
+ * @brief Make reactorRun() return after the current iteration
+ *
+ * @note It is the only function that can be called from any thread
+ */
+void reactorStop(synch_reactor_t *reactor){
+    uint64_t one = 1;
+
+    reactor->stopped = true;
+
+    if(write(reactor->wake_fd, &one, sizeof(uint64_t)) < 0)
+        return;
+}
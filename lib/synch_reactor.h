@@ -0,0 +1,111 @@
+/**
+ * @file synch_reactor.h
+ *
+ * @brief Event loop serving many groups from a single thread
+ *
+ * A reactor owns a set of opened thread_group_t structures and waits on all of
+ * them with epoll: messages are delivered to a per-group callback as soon as
+ * the group becomes readable, while writes are queued and completed from the
+ * loop. Group devices report readiness through their 'poll' file operation.
+ */
+
+
+#ifndef SYNCH_REACTOR_H
+#define SYNCH_REACTOR_H
+
+
+#include <sys/epoll.h>
+
+#include "thread_synch.h"
+
+
+#define REACTOR_MAX_EVENTS      64      /**< Readiness events handled by each iteration */
+#define REACTOR_READ_BATCH      32      /**< Messages read from a group by the single syscall of each readiness event */
+#define REACTOR_WRITE_BATCH     32      /**< Queued writes issued on a group for each readiness event */
+#define REACTOR_BUFF_SIZE       4096    /**< Default size of each receive buffer */
+
+
+/**
+ * @brief Called for each message read from a group
+ *
+ * The buffer is owned by the reactor and is reused after the callback returns
+ */
+typedef void (*reactor_msg_cb)(thread_group_t *group, const void *buffer, size_t len, void *arg);
+
+/**
+ * @brief Called when a queued write completes
+ *
+ * 'result' is the value returned by writeMessage(): the number of written
+ * bytes, or a negative number on error
+ */
+typedef void (*reactor_write_cb)(thread_group_t *group, int result, void *arg);
+
+
+/**
+ * @brief Write waiting to be issued on a group
+ */
+typedef struct T_REACTOR_WRITE {
+    const void *buffer;             /**< Message to write, owned by the caller until completion */
+    size_t len;
+    reactor_write_cb on_complete;   /**< Completion callback, may be NULL */
+    void *arg;
+
+    struct T_REACTOR_WRITE *next;
+} reactor_write_t;
+
+/**
+ * @brief Group registered on a reactor
+ */
+typedef struct T_REACTOR_ENTRY {
+    thread_group_t *group;
+    reactor_msg_cb on_message;      /**< Message callback, NULL to only write */
+    void *arg;
+
+    reactor_write_t *write_head;    /**< FIFO of queued writes */
+    reactor_write_t *write_tail;
+    uint32_t events;                /**< Events currently requested to epoll */
+    bool removed;                   /**< Set by reactorRemoveGroup(), freed at the end of the iteration */
+
+    struct T_REACTOR_ENTRY *next;
+} reactor_entry_t;
+
+/**
+ * @brief Event loop over a set of groups
+ *
+ * @note Functions must be called by the thread running the loop (callbacks
+ *          included), except for reactorStop()
+ */
+typedef struct T_SYNCH_REACTOR {
+    int epoll_fd;
+    int wake_fd;                    /**< Eventfd used by reactorStop() */
+
+    reactor_entry_t *entries;       /**< Registered groups */
+
+    char *buffer;                   /**< 'REACTOR_READ_BATCH' receive buffers shared by all the groups, grown to fit longer messages */
+    size_t buffer_size;             /**< Size of each receive buffer */
+
+    volatile bool stopped;
+} synch_reactor_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+synch_reactor_t *createReactor(const size_t buffer_size);
+void destroyReactor(synch_reactor_t *reactor);
+
+int reactorAddGroup(synch_reactor_t *reactor, thread_group_t *group, reactor_msg_cb on_message, void *arg);
+int reactorRemoveGroup(synch_reactor_t *reactor, thread_group_t *group);
+int reactorQueueWrite(synch_reactor_t *reactor, thread_group_t *group, const void *buffer, size_t len, reactor_write_cb on_complete, void *arg);
+
+int reactorRunOnce(synch_reactor_t *reactor, const int timeout);
+int reactorRun(synch_reactor_t *reactor);
+void reactorStop(synch_reactor_t *reactor);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  //SYNCH_REACTOR_H
@@ -30,270 +30,198 @@ static int _cancelDelay(int group_fd){
     return ret;
 }
 
-static int _getParamPath(const int group_id, const char *param_name, char *dest_buffer, size_t dest_size){
-    char param_path[BUFF_SIZE];
-    int ret;
-    size_t len;
-    
-    ret = snprintf(param_path, BUFF_SIZE, param_default_path, group_id);
-
-    strncat(param_path, param_name, BUFF_SIZE);
-
-    len = strnlen(param_path, BUFF_SIZE);
-
-    if(dest_size < len)
-        return -1;
-
-    strncpy(dest_buffer, param_path, dest_size);
+/**
+ * @brief Advance the generation of a mapped barrier, resetting the arrivals
+ * 
+ * @param[in] *barrier The mapped barrier
+ * @param[in,out] *state The expected state word, updated on failure
+ * 
+ * @retval true on success
+ * @retval false if the state changed
+ */
+static bool _releaseGeneration(barrier_shared_t *barrier, int64_t *state){
+    int64_t next = BARRIER_STATE(BARRIER_GENERATION(*state) + 1, 0);
 
-    return 0;
+    return __atomic_compare_exchange_n(&barrier->state, state, next, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
 }
 
-static int _readMaxMsgSize(unsigned long *_val, const int group_id){
-    FILE *fd;
-    int ret;
-    const char *param_name = "max_message_size";
-    char param_path[BUFF_SIZE];
-    char buffer[BUFF_SIZE];
-
-
-    if(_getParamPath(group_id, param_name, param_path, BUFF_SIZE) < 0)
-        return -1;
-
-
-    fd = fopen(param_path, "rt"); 
-
-    if(fd < 0){
-        printf("[X] Error while opening the group file\n");
-        return -1;
-    }
-
-
-    ret = fread(buffer, sizeof(char), BUFF_SIZE, fd);
-    if(ret < 0){
-        printf("[X] Errror while reading parameters: %d\n", ret);
-        return -1;
-    }
-
-    *_val = strtoul(buffer, NULL, 10);
+/**
+ * @brief Enter the kernel to wake up sleepers of a mapped barrier, only if there are some
+ * 
+ * Registered eventfds are signalled by the same syscall
+ */
+static int _wakeSleepers(thread_group_t *group){
 
-    fclose(fd);
+    //The generation update is sequentially consistent, so no sleeper is missed
+    if(__atomic_load_n(&group->barrier_counters->sleepers, __ATOMIC_SEQ_CST) == 0 &&
+        __atomic_load_n(&group->barrier_counters->watchers, __ATOMIC_SEQ_CST) == 0)
+        return 0;
 
-    return 0;
+    return ioctl(group->file_descriptor, IOCTL_BARRIER_WAKE);
 }
 
-static int _readMaxStorageSize(unsigned long *_val, const int group_id){
-    FILE *fd;
-    int ret;
-    const char *param_name = "max_storage_size";
-    char param_path[BUFF_SIZE];
-    char buffer[BUFF_SIZE];
-
-
-    if(_getParamPath(group_id, param_name, param_path, BUFF_SIZE) < 0)
-        return -1;
-
-
-    fd = fopen(param_path, "rt"); 
-
-    if(fd < 0){
-        printf("[X] Error while opening the group file\n");
-        return -1;
-    }
-
+/**
+ * @brief Wait until the generation of a mapped barrier differs from 'generation'
+ * 
+ * The generation is checked BARRIER_SPIN_COUNT times before sleeping in the kernel
+ */
+static int _waitGeneration(thread_group_t *group, const uint32_t generation){
+    int i;
 
-    ret = fread(buffer, sizeof(char), BUFF_SIZE, fd);
-    if(ret < 0){
-        printf("[X] Errror while reading parameters: %d", ret);
-        return -1;
+    for(i = 0; i < BARRIER_SPIN_COUNT; i++){
+        if(BARRIER_GENERATION(__atomic_load_n(&group->barrier->state, __ATOMIC_ACQUIRE)) != generation)
+            return 0;
     }
 
-    *_val = strtoul(buffer, NULL, 10);
-
-    fclose(fd);
-
-    return 0;
+    return ioctl(group->file_descriptor, IOCTL_BARRIER_WAIT, generation);
 }
 
-static int _readCurrStorageSize(unsigned long *_val, const int group_id){
-    FILE *fd;
-    int ret;
-    const char *param_name = "current_message_size";
-    char param_path[BUFF_SIZE];
-    char buffer[BUFF_SIZE];
-
-
-    if(_getParamPath(group_id, param_name, param_path, BUFF_SIZE) < 0)
-        return -1;
-
-
-
-    if(ret < 0 || ret > BUFF_SIZE)
-        return -1;
-
-
-    fd = fopen(param_path, "rt"); 
-
-    if(!fd){
-        printf("[X] Error while opening the group file: %d\n", errno);
-        return -1;
-    }
-
-
-    ret = fread(buffer, sizeof(char), 64, fd);
-    if(ferror(fd) != 0){
-        printf("[X] Errror while reading parameters: %d", ret);
-        return -1;
-    }
-
-    *_val = strtoul(buffer, NULL, 10);
-
-    fclose(fd);
+/**
+ * @brief Sysfs attributes cached by a group structure, indexed by 'group_param_t'
+ */
+static const struct {
+    const char *name;
+    int flags;
+} _params[PARAM_NUMBER] = {
+    [PARAM_MAX_MESSAGE_SIZE]        = {"max_message_size", O_RDWR},
+    [PARAM_MAX_STORAGE_SIZE]        = {"max_storage_size", O_RDWR},
+    [PARAM_CURRENT_STORAGE_SIZE]    = {"current_storage_size", O_RDONLY},
+    [PARAM_GARBAGE_COLLECTOR_RATIO] = {"garbage_collector_ratio", O_RDWR},
+    [PARAM_INCLUDE_STRUCT_SIZE]     = {"include_struct_size", O_RDWR},
+};
 
-    return 0;
+/**
+ * @brief Check if an ioctl failed because the module does not know it
+ * 
+ * @note Older modules reject unknown commands with -1, seen as 'EPERM'
+ */
+static bool _isUnknownIoctl(const int error){
+    return error == ENOTTY || error == EPERM;
 }
 
-static int _readGroupParameter(unsigned long *_val, const int group_id, const char *param_name){
-    FILE *fd;
-    int ret;
+static int _getParamPath(const int group_id, const char *param_name, char *dest_buffer, size_t dest_size){
     char param_path[BUFF_SIZE];
-    char buffer[BUFF_SIZE];
-
-
-    if(_getParamPath(group_id, param_name, param_path, BUFF_SIZE) < 0)
-        return -1;
-
-
-    fd = fopen(param_path, "rt"); 
+    int ret;
+    size_t len;
+    
+    ret = snprintf(param_path, BUFF_SIZE, param_default_path, group_id);
 
-    if(fd < 0){
-        printf("[X] Error while opening the group file\n");
-        return -1;
-    }
+    strncat(param_path, param_name, BUFF_SIZE);
 
+    len = strnlen(param_path, BUFF_SIZE);
 
-    ret = fread(buffer, sizeof(char), BUFF_SIZE, fd);
-    if(ret < 0){
-        printf("[X] Errror while reading parameters: %d\n", ret);
+    if(dest_size < len)
         return -1;
-    }
-
-    *_val = strtoul(buffer, NULL, 10);
 
-    fclose(fd);
+    strncpy(dest_buffer, param_path, dest_size);
 
     return 0;
-
 }
 
-static int _setMaxMsgSize(const int group_id, const unsigned long _val){
-    int fd;
-    int ret;
-    char param_path[BUFF_SIZE];
-
-    if(_getParamPath(group_id, "max_message_size", param_path, BUFF_SIZE) < 0)
-        return -1;
-
-    fd = open(param_path, O_WRONLY); 
+static void _initParamCache(thread_group_t *group){
+    int i;
 
-    if(fd < 0){
-        printf("[X] Error while opening the group file\n");
-        return -1;
-    }
+    for(i = 0; i < PARAM_NUMBER; i++)
+        group->param_fd[i] = -1;
+}
 
+static void _closeParamCache(thread_group_t *group){
+    int i;
 
-    char buff[BUFF_SIZE];
+    for(i = 0; i < PARAM_NUMBER; i++){
+        if(group->param_fd[i] != -1)
+            close(group->param_fd[i]);
 
-    if(sprintf(buff, "%ld", _val) < 0){
-        printf("[X] Error while converting the paramtere value");
-        return -1;
+        group->param_fd[i] = -1;
     }
-
-    ret = write(fd, buff, sizeof(char)*strnlen(buff, BUFF_SIZE));
-
-    return ret;
 }
 
-static int _setMaxStorageSize(const int group_id, const unsigned long _val){
-    int fd;
-    int ret;
+/**
+ * @brief Get the file descriptor of a sysfs attribute, opening it at the first use
+ * 
+ * @retval The file descriptor
+ * @retval -1 on error
+ * 
+ * @note Threads sharing the group may open the attribute concurrently: the 
+ *          first descriptor published is kept, the others are closed
+ */
+static int _getParamFd(thread_group_t *group, const group_param_t param){
     char param_path[BUFF_SIZE];
+    int expected = -1;
+    int fd;
+
+    fd = __atomic_load_n(&group->param_fd[param], __ATOMIC_ACQUIRE);
+    if(fd != -1)
+        return fd;
 
-    if(_getParamPath(group_id, "max_storage_size", param_path, BUFF_SIZE) < 0)
+    if(_getParamPath(group->group_id, _params[param].name, param_path, BUFF_SIZE) < 0)
         return -1;
 
-    fd = open(param_path, O_WRONLY); 
+    fd = open(param_path, _params[param].flags | O_CLOEXEC);
 
     if(fd < 0){
         printf("[X] Error while opening the group file\n");
         return -1;
     }
 
-
-    char buff[BUFF_SIZE];
-
-    if(sprintf(buff, "%ld", _val) < 0){
-        printf("[X] Error while converting the paramtere value");
-        return -1;
+    if(!__atomic_compare_exchange_n(&group->param_fd[param], &expected, fd, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+        close(fd);
+        return expected;
     }
 
-    ret = write(fd, buff, sizeof(char)*strnlen(buff, BUFF_SIZE));
-
-    return ret;
+    return fd;
 }
 
-static int _setGarbCollRatio(const int group_id, const unsigned long _val){
+/**
+ * @brief Read a numeric sysfs attribute with a single syscall
+ * 
+ * @note Sysfs regenerates the value at each read from offset 0, so the
+ *      cached descriptor never needs to be rewound
+ */
+static int _readParam(thread_group_t *group, const group_param_t param, unsigned long *_val){
+    char buff[ATTR_BUFF_SIZE];
+    char *end;
+    ssize_t len;
     int fd;
-    int ret;
-    char param_path[BUFF_SIZE];
 
-    if(_getParamPath(group_id, "garbage_collector_ratio", param_path, BUFF_SIZE) < 0)
+    if((fd = _getParamFd(group, param)) < 0)
         return -1;
 
-    fd = open(param_path, O_WRONLY); 
+    len = pread(fd, buff, ATTR_BUFF_SIZE - 1, 0);
 
-    if(fd < 0){
-        printf("[X] Error while opening the group file\n");
+    if(len <= 0)
         return -1;
-    }
 
+    buff[len] = '\0';
 
-    char buff[BUFF_SIZE];
+    errno = 0;
+    *_val = strtoul(buff, &end, 10);
 
-    if(sprintf(buff, "%lu", _val) < 0){
-        printf("[X] Error while converting the paramtere value");
+    if(errno != 0 || end == buff)
         return -1;
-    }
-    ret = write(fd, buff, sizeof(char)*strnlen(buff, BUFF_SIZE));
 
-    return ret;
+    return 0;
 }
 
-static int _setStructSizeFlag(const int group_id, const bool _val){
+static int _writeParam(thread_group_t *group, const group_param_t param, const unsigned long _val){
+    char buff[ATTR_BUFF_SIZE];
+    int len;
     int fd;
-    int ret;
-    char param_path[BUFF_SIZE];
 
-    if(_getParamPath(group_id, "include_struct_size", param_path, BUFF_SIZE) < 0)
+    if((fd = _getParamFd(group, param)) < 0)
         return -1;
 
-    fd = open(param_path, O_WRONLY); 
+    len = snprintf(buff, ATTR_BUFF_SIZE, "%lu", _val);
 
-    if(fd < 0){
-        printf("[X] Error while opening the group file\n");
+    if(len < 0 || len >= ATTR_BUFF_SIZE){
+        printf("[X] Error while converting the paramtere value");
         return -1;
     }
 
-
-    char buff[BUFF_SIZE];
-
-    if(sprintf(buff, "%d", (int)_val) < 0){
-        printf("[X] Error while converting the paramtere value");
+    if(pwrite(fd, buff, len, 0) != len)
         return -1;
-    }
-    ret = write(fd, buff, sizeof(char)*strnlen(buff, BUFF_SIZE));
 
-    return ret;    
+    return 0;
 }
 
 static int _getGroupID(group_t *descriptor, thread_synch_t *main_synch){
@@ -393,6 +321,27 @@ int initThreadSyncher(thread_synch_t *main_syncher){
 }
 
 
+/**
+ * @brief Release the resources of an initialized 'thread_synch_t' structure
+ * 
+ * @param[in] main_syncher A pointer to the structure to release
+ * 
+ * @note The structure itself is not deallocated, since it is owned by the caller
+ */
+void releaseThreadSyncher(thread_synch_t *main_syncher){
+
+    if(!main_syncher || !main_syncher->initialized)
+        return;
+
+    close(main_syncher->main_file_descriptor);
+    free(main_syncher->main_device_path);
+
+    main_syncher->main_file_descriptor = -1;
+    main_syncher->main_device_path = NULL;
+    main_syncher->initialized = 0;
+}
+
+
 /**
  * @brief Open a group, the thread PID is added to group's active members
  * 
@@ -428,6 +377,32 @@ int openGroup(thread_group_t* group){
     return 0;
 }
 
+/**
+ * @brief Open a group as a handle shared by several threads
+ * 
+ * The group's member belongs to the file descriptor instead of the thread
+ * that opened it: any thread using the structure reads and writes on behalf
+ * of the same member, and each message is delivered once to the whole pool.
+ * 
+ * @retval 0 on success
+ * @retval PERMISSION_ERR on permission Error
+ * @retval negative number on error
+ * 
+ * @note If the group is already open its descriptor is shared, but messages
+ *          already read through it are delivered again
+ */
+int openSharedGroup(thread_group_t* group){
+    int ret;
+
+    if((ret = openGroup(group)) < 0)
+        return ret;
+
+    if(ioctl(group->file_descriptor, IOCTL_SHARE_HANDLE) < 0)
+        return -errno;
+
+    return 0;
+}
+
 
 /**
  * @brief Install a group in the system given a group descriptor
@@ -466,7 +441,7 @@ thread_group_t* installGroup(const group_t group_descriptor, thread_synch_t *mai
 
     new_group->group_id = group_id;
 
-    max_size = strnlen(group_default_path, DEVICE_NAME_SIZE) + 4;   //Max group ID=255
+    max_size = strnlen(group_default_path, DEVICE_NAME_SIZE) + 6;   //Max group ID=65535
 
     new_group->group_path = (char*)malloc(sizeof(char)*max_size);
     if(!new_group->group_path)
@@ -494,6 +469,9 @@ thread_group_t* installGroup(const group_t group_descriptor, thread_synch_t *mai
 
 
     new_group->file_descriptor = -1;    //The user should open the file
+    new_group->barrier = NULL;
+    new_group->barrier_counters = NULL;
+    _initParamCache(new_group);
 
     return new_group;
 
@@ -505,6 +483,91 @@ thread_group_t* installGroup(const group_t group_descriptor, thread_synch_t *mai
     
 }
 
+/**
+ * @brief Install several configured groups with a single request
+ * 
+ * @param[in,out] *specs Array of group specifications, on return the 'group_id'
+ *                  field of each element contains the assigned ID or an error code
+ * @param[in] count The number of elements of 'specs'
+ * @param[in] *main_synch Pointer to a thread_synch_t main structure
+ * 
+ * @retval The number of groups installed
+ * @retval -1 on error
+ * 
+ * @note Installed groups can be loaded with loadGroupFromID()
+ */
+int installGroups(group_spec_t *specs, size_t count, thread_synch_t *main_synch){
+    group_install_t request;
+    int ret;
+
+    if(!main_synch || !main_synch->initialized || !specs)
+        return -1;
+
+    request.specs = specs;
+    request.count = count;
+
+    ret = ioctl(main_synch->main_file_descriptor, IOCTL_INSTALL_GROUPS, &request);
+
+    if(ret < 0)
+        return -1;
+
+    return ret;
+}
+
+/**
+ * @brief Uninstall a group from the system
+ * 
+ * @param[in] *group A pointer to the group's structure to uninstall
+ * @param[in] *main_synch Pointer to a thread_synch_t main structure
+ * 
+ * @retval 0 on success
+ * @retval -1 on error
+ * 
+ * @note The group is closed and its structure deallocated only on success
+ * @note Processes which still have the group opened can release it, but
+ *          any other operation fails
+ */
+int uninstallGroup(thread_group_t *group, thread_synch_t *main_synch){
+    int ret;
+
+    if(!main_synch || !main_synch->initialized || !group)
+        return -1;
+
+    ret = ioctl(main_synch->main_file_descriptor, IOCTL_UNINSTALL_GROUP, group->group_id);
+
+    if(ret < 0)
+        return -1;
+
+    unloadGroup(group);
+
+    return 0;
+}
+
+/**
+ * @brief Release a group structure without uninstalling the group
+ * 
+ * The group is closed, the barrier unmapped and the cached sysfs 
+ * descriptors closed before deallocating the structure
+ * 
+ * @param[in] *group A pointer to the group's structure, may be NULL
+ */
+void unloadGroup(thread_group_t *group){
+
+    if(!group)
+        return;
+
+    unmapBarrier(group);
+
+    if(group->file_descriptor != -1)
+        close(group->file_descriptor);
+
+    _closeParamCache(group);
+
+    free(group->descriptor.group_name);
+    free(group->group_path);
+    free(group);
+}
+
 
 /**
  * @brief Read a message from a given group
@@ -515,11 +578,11 @@ thread_group_t* installGroup(const group_t group_descriptor, thread_synch_t *mai
  * 
  * @retval NO_MSG_PRESENT if there is no message available
  * @retval GROUP_CLOSED if the provided group is closed
+ * @retval MSG_SIZE_ERROR if the message is longer than 'len', it is left in the group
  * @retval negative number on error
  * @retval 0 on success
  * 
- * @note Even if the parameter 'len' is less the the size of the actual message, the message 
- *          is considered delivered and thus removed from the queue
+ * @note nextMessageSize() reports the size of the buffer needed
  */
 int readMessage(void *buffer, size_t len, thread_group_t *group){
 
@@ -537,7 +600,7 @@ int readMessage(void *buffer, size_t len, thread_group_t *group){
     if(ret == 0)
         return NO_MSG_PRESENT;
     else if(ret < 0)
-        return -1;
+        return errno == EMSGSIZE ? MSG_SIZE_ERROR : -1;
 
     return 0;
 }
@@ -566,6 +629,139 @@ int writeMessage(const void *buffer, size_t len, thread_group_t *group){
     return ret;
 }
 
+/**
+ * @brief Read several messages from a given group
+ * 
+ * @param[in,out] *messages Array of messages: 'buffer' and 'size' describe the 
+ *                  destination buffers, 'size' must not be 0. On return 'size'
+ *                  holds the read bytes and 'author' the author of each message
+ * @param[in]  count The number of elements of 'messages'
+ * @param[in]  group A pointer to the group's structure where the msgs are readed
+ * 
+ * @retval The number of messages read, 0 if no message is available
+ * @retval GROUP_CLOSED if the provided group is closed
+ * @retval MSG_SIZE_ERROR if the next message is longer than the first buffer
+ * @retval -1 on error, also when a message was taken from the group but its
+ *          buffer was not writable, even if other messages were read
+ * 
+ * @note All the messages are read with a single syscall, which stops at a 
+ *          message longer than its buffer and leaves it in the group. With 
+ *          modules that lack the batched ioctl they are read one at a time, 
+ *          longer messages are truncated and 'author' is set to 0
+ */
+int readMessages(msg_t *messages, size_t count, thread_group_t *group){
+    msg_batch_t batch;
+    ssize_t len = 0;
+    size_t i;
+    int ret;
+
+    if(group == NULL || group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    if(!messages)
+        return -1;
+
+    batch.messages = messages;
+    batch.count = count;
+
+    ret = ioctl(group->file_descriptor, IOCTL_READ_MESSAGES, &batch);
+
+    if(ret >= 0)
+        return ret;
+    if(!_isUnknownIoctl(errno))
+        return errno == EMSGSIZE ? MSG_SIZE_ERROR : -1;
+
+    //Fallback for modules without the batched path
+    for(i = 0; i < count; i++){
+        len = read(group->file_descriptor, messages[i].buffer, messages[i].size);
+
+        if(len <= 0)
+            break;
+
+        messages[i].size = len;
+        messages[i].author = 0;
+    }
+
+    return (i == 0 && len < 0) ? -1 : (int)i;
+}
+
+/**
+ * @brief Get the size of the next message that would be read from a group
+ * 
+ * @param[in]  group A pointer to an opened group structure
+ * @param[out] *size The size of the message
+ * 
+ * @retval 0 if a message is available
+ * @retval NO_MSG_PRESENT if no message is available
+ * @retval GROUP_CLOSED if the provided group is closed
+ * @retval UNSUPPORTED_ERR if the module cannot report the size
+ * @retval -1 on error
+ * 
+ * @note The message is not read. The next read of the calling thread returns
+ *          it, unless the group was opened with openSharedGroup() and another
+ *          thread reads first
+ */
+int nextMessageSize(thread_group_t *group, size_t *size){
+    int ret;
+
+    if(group == NULL || group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    if(!size)
+        return -1;
+
+    ret = ioctl(group->file_descriptor, IOCTL_NEXT_MESSAGE_SIZE, size);
+
+    if(ret < 0)
+        return _isUnknownIoctl(errno) ? UNSUPPORTED_ERR : -1;
+
+    return ret == 0 ? 0 : NO_MSG_PRESENT;
+}
+
+/**
+ * @brief Write several messages in a given group
+ * 
+ * @param[in] *messages Array of messages, described by 'buffer' and 'size'
+ * @param[in]  count The number of elements of 'messages'
+ * @param[in]  group A pointer to the group's structure where the msgs are written
+ * 
+ * @retval The number of messages written, writing stops at the first failure
+ * @retval GROUP_CLOSED if the provided group is closed
+ * @retval -1 on error
+ * 
+ * @note All the messages are written with a single syscall, or one at a time
+ *          with modules that lack the batched ioctl
+ */
+int writeMessages(const msg_t *messages, size_t count, thread_group_t *group){
+    msg_batch_t batch;
+    size_t i;
+    int ret;
+
+    if(group == NULL || group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    if(!messages)
+        return -1;
+
+    batch.messages = (msg_t*)messages;
+    batch.count = count;
+
+    ret = ioctl(group->file_descriptor, IOCTL_WRITE_MESSAGES, &batch);
+
+    if(ret >= 0)
+        return ret;
+    if(!_isUnknownIoctl(errno))
+        return -1;
+
+    //Fallback for modules without the batched path
+    for(i = 0; i < count; i++){
+        if(write(group->file_descriptor, messages[i].buffer, messages[i].size) < 0)
+            break;
+    }
+
+    return (i == 0 && count > 0) ? -1 : (int)i;
+}
+
 /**
  * @brief Set the delay value for a given group
  * 
@@ -612,7 +808,7 @@ int revokeDelay(thread_group_t *group){
  * 
  * @param[in] *group T A pointer to an initialized group structure
  * 
- * @retval Negative number on error
+ * @retval Negative number on error, errno is set to EINTR if a signal interrupted the sleep
  * @retval 0 on success
  * @retval GROUP_CLOSED if the provided group is closed
  */
@@ -622,11 +818,36 @@ int sleepOnBarrier(thread_group_t *group){
     if(group->file_descriptor == -1)
         return GROUP_CLOSED;
 
+    if(group->barrier)
+        return _waitGeneration(group, BARRIER_GENERATION(__atomic_load_n(&group->barrier->state, __ATOMIC_ACQUIRE)));
+
     ret = ioctl(group->file_descriptor, IOCTL_SLEEP_ON_BARRIER);
 
     return ret;
 }
 
+/**
+ * @brief Put the process which call this function on sleep for at most 'timeout' ms
+ * 
+ * @param[in] *group T A pointer to an initialized group structure
+ * @param[in] timeout The maximum sleeping time in milliseconds
+ * 
+ * @retval 0 if the process was woken up
+ * @retval BARRIER_TIMED_OUT if the timeout expired
+ * @retval Negative number on error, errno is set to EINTR if a signal interrupted the sleep
+ * @retval GROUP_CLOSED if the provided group is closed
+ */
+int sleepOnBarrierTimeout(thread_group_t *group, const long timeout){
+    int ret;
+
+    if(group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    ret = ioctl(group->file_descriptor, IOCTL_SLEEP_ON_BARRIER_TIMEOUT, timeout);
+
+    return ret;
+}
+
 /**
  * @brief Awake all the process present in a wait queue for a given group
  * 
@@ -637,16 +858,270 @@ int sleepOnBarrier(thread_group_t *group){
  * @retval GROUP_CLOSED if the provided group is closed
  */
 int awakeBarrier(thread_group_t *group){
+    int64_t state;
     int ret;
 
     if(group->file_descriptor == -1)
         return GROUP_CLOSED;
 
+    if(group->barrier){
+        state = __atomic_load_n(&group->barrier->state, __ATOMIC_RELAXED);
+
+        while(!_releaseGeneration(group->barrier, &state));
+
+        return _wakeSleepers(group);
+    }
+
     ret = ioctl(group->file_descriptor, IOCTL_AWAKE_BARRIER);
 
     return ret;    
 }
 
+/**
+ * @brief Awake at most 'count' processes sleeping on the barrier of a given group
+ * 
+ * Processes are woken up in the same order they went to sleep, the others
+ * keep sleeping.
+ * 
+ * @param[in] *group T A pointer to an initialized group structure
+ * @param[in] count The number of processes to awake
+ * 
+ * @retval -1 on error
+ * @retval 0 on success
+ * @retval GROUP_CLOSED if the provided group is closed
+ */
+int awakeBarrierN(thread_group_t *group, const unsigned int count){
+    int ret;
+
+    if(group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    ret = ioctl(group->file_descriptor, IOCTL_AWAKE_BARRIER_N, count);
+
+    return ret;
+}
+
+/**
+ * @brief Arrive on the group's counted barrier and sleep until all parties arrived
+ * 
+ * @param[in] *group T A pointer to an initialized group structure
+ * 
+ * @retval BARRIER_SERIAL_THREAD to the thread whose arrival released the barrier
+ * @retval 0 to the other threads
+ * @retval -1 on error (e.g. the number of parties is not set)
+ * @retval GROUP_CLOSED if the provided group is closed
+ * 
+ * @note A thread woken up by awakeBarrierN() before the barrier is released
+ *          gets 0 as well, but its arrival is withdrawn: it must arrive again
+ */
+int arriveOnBarrier(thread_group_t *group){
+    barrier_shared_t *barrier = group->barrier;
+    int64_t state, next;
+    uint32_t parties;
+    int ret;
+
+    if(group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    if(barrier){
+        parties = __atomic_load_n(&group->barrier_counters->parties, __ATOMIC_ACQUIRE);
+
+        if(parties == 0){
+            errno = EINVAL;
+            return -1;
+        }
+
+        state = __atomic_load_n(&barrier->state, __ATOMIC_RELAXED);
+
+        for(;;){
+            if(BARRIER_ARRIVED(state) + 1 >= parties){
+                if(!_releaseGeneration(barrier, &state))
+                    continue;
+
+                if(_wakeSleepers(group) < 0)
+                    return -1;
+
+                return BARRIER_SERIAL_THREAD;
+            }
+
+            next = BARRIER_STATE(BARRIER_GENERATION(state), BARRIER_ARRIVED(state) + 1);
+
+            if(__atomic_compare_exchange_n(&barrier->state, &state, next, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+                break;
+        }
+
+        ret = _waitGeneration(group, BARRIER_GENERATION(next));
+
+        //Interrupted, or woken up by awakeBarrierN() without a release
+        if(ret == 0 || errno == EINTR){
+            //Withdraw the arrival, unless the barrier was released in the meantime
+            state = __atomic_load_n(&barrier->state, __ATOMIC_RELAXED);
+
+            do{
+                if(BARRIER_GENERATION(state) != BARRIER_GENERATION(next) || BARRIER_ARRIVED(state) == 0)
+                    return 0;
+            }while(!__atomic_compare_exchange_n(&barrier->state, &state, state - 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+        }
+
+        return ret;
+    }
+
+    ret = ioctl(group->file_descriptor, IOCTL_BARRIER_ARRIVE);
+
+    return ret;
+}
+
+/**
+ * @brief Map the barrier state of a given group in the process address space
+ * 
+ * Once mapped, sleepOnBarrier(), awakeBarrier() and arriveOnBarrier() operate 
+ * directly on the shared state and enter the kernel only to sleep or to wake
+ * up threads that are actually sleeping.
+ * 
+ * @param[in] *group T A pointer to an initialized group structure
+ * 
+ * @retval 0 on success
+ * @retval -1 on error
+ * @retval GROUP_CLOSED if the provided group is closed
+ */
+int mapBarrier(thread_group_t *group){
+    long page_size;
+    void *addr;
+    void *counters;
+
+    if(group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    if(group->barrier)
+        return 0;
+
+    page_size = sysconf(_SC_PAGESIZE);
+
+    addr = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, group->file_descriptor, BARRIER_STATE_PGOFF * page_size);
+
+    if(addr == MAP_FAILED)
+        return -1;
+
+    //Counters are owned by the kernel, which only allows reading them
+    counters = mmap(NULL, page_size, PROT_READ, MAP_SHARED, group->file_descriptor, BARRIER_COUNTERS_PGOFF * page_size);
+
+    if(counters == MAP_FAILED){
+        munmap(addr, page_size);
+        return -1;
+    }
+
+    group->barrier = (barrier_shared_t*)addr;
+    group->barrier_counters = (const barrier_counters_t*)counters;
+
+    return 0;
+}
+
+/**
+ * @brief Unmap the barrier state of a given group, if mapped
+ * 
+ * @param[in] *group T A pointer to an initialized group structure
+ */
+void unmapBarrier(thread_group_t *group){
+
+    if(!group->barrier)
+        return;
+
+    munmap(group->barrier, sysconf(_SC_PAGESIZE));
+    munmap((void*)group->barrier_counters, sysconf(_SC_PAGESIZE));
+    group->barrier = NULL;
+    group->barrier_counters = NULL;
+}
+
+/**
+ * @brief Register an eventfd that is signalled whenever the group's barrier is released
+ * 
+ * This allows event-loop applications to wait for barrier phases via 
+ * epoll/poll on 'event_fd' instead of sleeping on the barrier.
+ * 
+ * @param[in] *group T A pointer to an initialized group structure
+ * @param[in] event_fd A file descriptor created by eventfd()
+ * 
+ * @retval 0 on success
+ * @retval -1 on error
+ * @retval GROUP_CLOSED if the provided group is closed
+ * 
+ * @note The registration is removed when the group file is closed
+ */
+int registerBarrierEventfd(thread_group_t *group, const int event_fd){
+
+    if(group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    return ioctl(group->file_descriptor, IOCTL_BARRIER_REGISTER_EVENTFD, event_fd);
+}
+
+/**
+ * @brief Remove an eventfd registered via registerBarrierEventfd()
+ * 
+ * @param[in] *group T A pointer to an initialized group structure
+ * @param[in] event_fd The registered eventfd
+ * 
+ * @retval 0 on success
+ * @retval -1 on error
+ * @retval GROUP_CLOSED if the provided group is closed
+ */
+int unregisterBarrierEventfd(thread_group_t *group, const int event_fd){
+
+    if(group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    return ioctl(group->file_descriptor, IOCTL_BARRIER_UNREGISTER_EVENTFD, event_fd);
+}
+
+/**
+ * @brief Set the number of threads that release the group's counted barrier
+ * 
+ * @param[in] *group T A pointer to an initialized group structure
+ * @param[in] parties The number of parties, 0 disables the counted barrier
+ * 
+ * @retval -1 on error
+ * @retval 0 on success
+ * @retval GROUP_CLOSED if the provided group is closed
+ * 
+ * @note If strict mode is enabled, only the owner can change the parties
+ */
+int setBarrierParties(thread_group_t *group, const unsigned int parties){
+    int ret;
+
+    if(group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    ret = ioctl(group->file_descriptor, IOCTL_SET_BARRIER_PARTIES, parties);
+
+    return ret;
+}
+
+/**
+ * @brief Get the configuration and the statistics of a group with a single syscall
+ * 
+ * @param[in] *group A pointer to an opened group structure
+ * @param[out] *snapshot Where the values are written
+ * 
+ * @retval 0 on success
+ * @retval GROUP_CLOSED if the provided group is closed
+ * @retval -1 on error
+ * 
+ * @note Fields that are not known by the running module are set to zero
+ */
+int getGroupStats(thread_group_t *group, group_snapshot_t *snapshot){
+
+    if(group->file_descriptor == -1)
+        return GROUP_CLOSED;
+
+    memset(snapshot, 0, sizeof(group_snapshot_t));
+    snapshot->size = sizeof(group_snapshot_t);
+
+    if(ioctl(group->file_descriptor, IOCTL_GET_GROUP_STATS, snapshot) < 0)
+        return -1;
+
+    return 0;
+}
+
 /**
  * @brief Get the maximum message size value for a given group
  * 
@@ -655,20 +1130,25 @@ int awakeBarrier(thread_group_t *group){
  * @retval The value of the parameter
  * @retval 0 on error
  * 
+ * @note If the group is closed, or the module cannot report statistics, the 
+ *          value is read from its sysfs attribute
  */
 unsigned long getMaxMessageSize(thread_group_t *group){
-    unsigned long val;
-    int ret;
+    group_snapshot_t snapshot;
+    unsigned long value;
+
+    if(group->file_descriptor != -1){
+        if(getGroupStats(group, &snapshot) == 0)
+            return snapshot.max_message_size;
+        if(!_isUnknownIoctl(errno))
+            return 0L;
+    }
 
-    if(group->file_descriptor == -1)
+    //Closed group, or module without the statistics ioctl
+    if(_readParam(group, PARAM_MAX_MESSAGE_SIZE, &value) < 0)
         return 0L;
 
-    ret = _readMaxMsgSize(&val, group->group_id);
-
-    if(ret < 0)
-        val = 0L;
-
-    return val;
+    return value;
 }
 
 /**
@@ -679,20 +1159,25 @@ unsigned long getMaxMessageSize(thread_group_t *group){
  * @retval The value of the parameter
  * @retval 0 on error
  * 
+ * @note If the group is closed, or the module cannot report statistics, the 
+ *          value is read from its sysfs attribute
  */
 unsigned long getMaxStorageSize(thread_group_t *group){
-    unsigned long val;
-    int ret;
+    group_snapshot_t snapshot;
+    unsigned long value;
+
+    if(group->file_descriptor != -1){
+        if(getGroupStats(group, &snapshot) == 0)
+            return snapshot.max_storage_size;
+        if(!_isUnknownIoctl(errno))
+            return 0L;
+    }
 
-    if(group->file_descriptor == -1)
+    //Closed group, or module without the statistics ioctl
+    if(_readParam(group, PARAM_MAX_STORAGE_SIZE, &value) < 0)
         return 0L;
 
-    ret = _readMaxStorageSize(&val, group->group_id);
-
-    if(ret < 0)
-        val = 0L;
-
-    return val;
+    return value;
 }
 
 /**
@@ -700,26 +1185,28 @@ unsigned long getMaxStorageSize(thread_group_t *group){
  * 
  * @param[in] *group T A pointer to an initialized group structure
  * 
- * @bug Sometimes this function will return the incorrect value "0", when this
- *          happens a subsequent call of the function will return the correct value
- * 
  * @retval The value of the parameter
  * @retval 0 on error
  * 
+ * @note If the group is closed, or the module cannot report statistics, the 
+ *          value is read from its sysfs attribute
  */
 unsigned long getCurrentStorageSize(thread_group_t *group){
-    unsigned long val;
-    int ret;
+    group_snapshot_t snapshot;
+    unsigned long value;
+
+    if(group->file_descriptor != -1){
+        if(getGroupStats(group, &snapshot) == 0)
+            return snapshot.current_storage_size;
+        if(!_isUnknownIoctl(errno))
+            return 0L;
+    }
 
-    if(group->file_descriptor == -1)
+    //Closed group, or module without the statistics ioctl
+    if(_readParam(group, PARAM_CURRENT_STORAGE_SIZE, &value) < 0)
         return 0L;
 
-    ret = _readCurrStorageSize(&val, group->group_id);
-
-    if(ret < 0)
-        val = 0L;
-
-    return val;
+    return value;
 }
 
 
@@ -742,7 +1229,7 @@ int setMaxMessageSize(thread_group_t *group, const unsigned long val){
     if(group->file_descriptor == -1)
         return GROUP_CLOSED;
 
-    if(_setMaxMsgSize(group->group_id, val) < 0)
+    if(_writeParam(group, PARAM_MAX_MESSAGE_SIZE, val) < 0)
         return -1;
     return 0;
 }
@@ -764,7 +1251,7 @@ int setMaxStorageSize(thread_group_t *group, const unsigned long val){
     if(group->file_descriptor == -1)
         return GROUP_CLOSED;
 
-    if(_setMaxStorageSize(group->group_id, val) < 0)
+    if(_writeParam(group, PARAM_MAX_STORAGE_SIZE, val) < 0)
         return -1;
     return 0;
 }
@@ -786,7 +1273,7 @@ int setGarbageCollectorRatio(thread_group_t *group, const unsigned long val){
     if(group->file_descriptor == -1)
         return GROUP_CLOSED;
 
-    if(_setGarbCollRatio(group->group_id, val) < 0)
+    if(_writeParam(group, PARAM_GARBAGE_COLLECTOR_RATIO, val) < 0)
         return -1;
     return 0;
 }
@@ -863,7 +1350,7 @@ int includeStructureSize(thread_group_t *group, const bool value){
     if(group->file_descriptor == -1)
         return GROUP_CLOSED;
 
-    ret = _setStructSizeFlag(group->file_descriptor, value);
+    ret = _writeParam(group, PARAM_INCLUDE_STRUCT_SIZE, value);
 
     if(ret < 0)
         return UNAUTHORIZED;
@@ -964,14 +1451,17 @@ thread_group_t *loadGroupFromDescriptor(const group_t *descriptor, thread_synch_
 
     path_len = strnlen(group_path, DEVICE_NAME_SIZE);
 
-    group->group_path = (char*)malloc(sizeof(char)*path_len);
+    group->group_path = (char*)malloc(sizeof(char)*path_len+1);
     if(!group->group_path)
-        goto cleanup1;
+        goto cleanup2;
 
 
-    strncpy(group->group_path, group_path, path_len);
+    strncpy(group->group_path, group_path, path_len+1);
     group->path_len = path_len;
     group->file_descriptor = -1;
+    group->barrier = NULL;
+    group->barrier_counters = NULL;
+    _initParamCache(group);
 
     return group;
 
@@ -1024,13 +1514,21 @@ thread_group_t* loadGroupFromID(const int group_id){
         return NULL;
 
     group->file_descriptor = fd;
+    group->barrier = NULL;
+    group->barrier_counters = NULL;
+    _initParamCache(group);
     group->group_id = group_id;
     group->descriptor.group_name = NULL;
     group->descriptor.name_len = 0;
     group->path_len = strnlen(group_path, BUFF_SIZE);
 
-    group->group_path = (char*)malloc(sizeof(char)*group->path_len);
-    strncpy(group->group_path, group_path, group->path_len);
+    group->group_path = (char*)malloc(sizeof(char)*group->path_len+1);
+    if(!group->group_path){
+        free(group);
+        close(fd);
+        return NULL;
+    }
+    strncpy(group->group_path, group_path, group->path_len+1);
 
     return group;
 }
@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 //#include <sys/poll.h>
 
 #include <unistd.h>
@@ -30,6 +31,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #define ATTR_BUFF_SIZE 64
 #define DEVICE_NAME_SIZE    64      /**< Maximum device name lenght*/
@@ -43,7 +45,7 @@
 
 
 #define GRP_MIN_ID 		0							/**< Group's min ID */
-#define GRP_MAX_ID		255							/**< Group's max ID */
+#define GRP_MAX_ID		65536						/**< Group's max ID (excluded) */
 
 
 /** @brief Errors code*/
@@ -56,6 +58,7 @@
 #define MSG_SIZE_ERROR      -12
 #define MEMORY_ERROR        -13
 #define STORAGE_SIZE_ERR    -14
+#define INVALID_CONFIG_ERR  -18
 
 
 
@@ -65,17 +68,24 @@
 #define UNAUTHORIZED    -52
 #define PERMISSION_ERR  -53
 #define GROUP_CLOSED    -54
+#define UNSUPPORTED_ERR -55
 
 
 
 #define BUFF_SIZE 512
 #define POLL_TIMEOUT 5
-#define PARAM_NUMBER 3
 /**
  * @brief ioctls 
  */
 
 #define IOCTL_GET_GROUP_DESC _IOR('Q', 1, group_t*)
+#define IOCTL_GET_GROUP_STATS _IOWR('Q', 2, group_snapshot_t*)
+#define IOCTL_SHARE_HANDLE _IO('Q', 3)
+#define IOCTL_READ_MESSAGES _IOWR('Q', 4, msg_batch_t*)
+#define IOCTL_WRITE_MESSAGES _IOW('Q', 5, msg_batch_t*)
+#define IOCTL_NEXT_MESSAGE_SIZE _IOR('Q', 6, size_t)
+
+#define GROUP_SNAPSHOT_VERSION  2   /**< Version of 'group_snapshot_t' known by the library */
 
 
 #define IOCTL_SET_SEND_DELAY _IOW('Y', 0, long)
@@ -85,9 +95,29 @@
 
 #define IOCTL_SLEEP_ON_BARRIER _IO('Z', 0)
 #define IOCTL_AWAKE_BARRIER _IO('Z', 1)
+#define IOCTL_BARRIER_ARRIVE _IO('Z', 2)
+#define IOCTL_SET_BARRIER_PARTIES _IOW('Z', 3, unsigned int)
+#define IOCTL_SLEEP_ON_BARRIER_TIMEOUT _IOW('Z', 4, long)
+#define IOCTL_AWAKE_BARRIER_N _IOW('Z', 5, unsigned int)
+#define IOCTL_BARRIER_WAIT _IOW('Z', 6, unsigned int)
+#define IOCTL_BARRIER_WAKE _IO('Z', 7)
+#define IOCTL_BARRIER_REGISTER_EVENTFD _IOW('Z', 8, int)
+#define IOCTL_BARRIER_UNREGISTER_EVENTFD _IOW('Z', 9, int)
+
+#define BARRIER_SERIAL_THREAD   1   /**< Returned by arriveOnBarrier() to the thread that released the barrier */
+#define BARRIER_TIMED_OUT       2   /**< Returned by sleepOnBarrierTimeout() when the timeout expires */
+#define BARRIER_SPIN_COUNT      1000    /**< Checks of a mapped barrier before sleeping in the kernel */
+#define BARRIER_STATE_PGOFF     0       /**< Page of the group device holding 'barrier_shared_t' */
+#define BARRIER_COUNTERS_PGOFF  1       /**< Page of the group device holding 'barrier_counters_t' */
+
+#define BARRIER_GENERATION(state)       ((uint32_t)((uint64_t)(state) >> 32))
+#define BARRIER_ARRIVED(state)          ((uint32_t)(state))
+#define BARRIER_STATE(gen, arrived)     ((int64_t)(((uint64_t)(gen) << 32) | (uint32_t)(arrived)))
 
 #define IOCTL_INSTALL_GROUP _IOW('X', 99, group_t*)
 #define IOCTL_GET_GROUP_ID  _IOW('X', 100, group_t*)
+#define IOCTL_UNINSTALL_GROUP _IOW('X', 101, int)
+#define IOCTL_INSTALL_GROUPS _IOWR('X', 102, group_install_t*)
 
 #define IOCTL_CHANGE_OWNER _IOW('Q', 102, uid_t)
 #define IOCTL_SET_STRICT_MODE _IOW('Q', 101, bool)
@@ -102,6 +132,14 @@ typedef struct t_message{
     size_t size;            /**< Size (in bytes) of the buffer*/
 } msg_t;
 
+/**
+ * @brief Argument of the batched read and write ioctls
+ */
+typedef struct msg_batch_t {
+    msg_t *messages;
+    size_t count;
+} msg_batch_t;
+
 /**
  * @brief System-wide descriptor of a group
  */
@@ -111,6 +149,123 @@ typedef struct group_t {
 } group_t;
 
 
+/**
+ * @brief Initial configuration of a group
+ * 
+ * Size fields set to 0 are replaced with the module's default values
+ */
+typedef struct group_config_t {
+    unsigned long max_message_size;     /**< Group's max message size, 0 for default*/
+    unsigned long max_storage_size;     /**< Max group storage size, 0 for default*/
+    int garbage_collector_ratio;        /**< Garbage collector ratio, in the range [0, 10]*/
+    bool garbage_collector_disabled;    /**< true to disable the garbage collector*/
+    bool include_struct_size;           /**< true to include supporting structures in the storage size*/
+    bool strict_mode;                   /**< true to enable the strict security mode*/
+    long message_delay;                 /**< Delay applied to the group's messages*/
+    unsigned int barrier_parties;       /**< Parties of the counted barrier, 0 to leave it unset*/
+} group_config_t;
+
+/**
+ * @brief Specification of a group to install with installGroups()
+ */
+typedef struct group_spec_t {
+    group_t descriptor;         /**< System-wide descriptor of the group */
+    group_config_t config;      /**< Initial configuration of the group */
+    int group_id;               /**< [out] Assigned ID or negative error code */
+} group_spec_t;
+
+/**
+ * @brief Argument of the 'IOCTL_INSTALL_GROUPS' ioctl
+ */
+typedef struct group_install_t {
+    group_spec_t *specs;
+    size_t count;
+} group_install_t;
+
+
+
+/**
+ * @brief Message counters of a group, summed over all the CPUs
+ */
+typedef struct group_counters_t {
+    uint64_t msg_written;       /**< Messages added to the FIFO queue */
+    uint64_t bytes_written;
+    uint64_t msg_read;          /**< Messages delivered to a reader */
+    uint64_t bytes_read;
+    uint64_t msg_rejected;      /**< Messages refused for the size limits */
+    uint64_t bytes_rejected;
+    uint64_t msg_delayed;       /**< Messages put in the delayed queue */
+    uint64_t bytes_delayed;
+    uint64_t msg_revoked;       /**< Delayed messages revoked */
+    uint64_t bytes_revoked;
+    uint64_t msg_reclaimed;     /**< Messages freed by the garbage collector */
+    uint64_t bytes_reclaimed;
+} group_counters_t;
+
+/**
+ * @brief Configuration and statistics of a group, see getGroupStats()
+ * 
+ * Fields are only appended by newer modules: 'version' and 'size' tell how
+ * much of the structure was filled.
+ */
+typedef struct group_snapshot_t {
+    uint32_t version;               /**< Version of the structure filled by the module */
+    uint32_t size;                  /**< Bytes written by the module */
+
+    uint64_t max_message_size;
+    uint64_t max_storage_size;
+    uint64_t current_storage_size;
+    int64_t message_delay;
+    uint32_t garbage_collector_ratio;
+    uint32_t barrier_parties;
+    uint32_t owner;
+    uint8_t strict_mode;
+    uint8_t garbage_collector_disabled;
+    uint8_t include_struct_size;
+    uint8_t reserved;
+
+    uint64_t queue_depth;           /**< Messages in the FIFO queue */
+    uint64_t peak_queue_depth;
+    uint64_t peak_storage_size;
+    uint32_t members;               /**< Active members of the group */
+    uint32_t peak_members;
+
+    group_counters_t counters;
+
+    //Version 2
+    uint64_t delayed_depth;         /**< Messages waiting in the delayed queue */
+} group_snapshot_t;
+
+
+/**
+ * @brief Barrier state shared with the kernel, see mapBarrier()
+ */
+typedef struct barrier_shared_t {
+    int64_t state;              /**< Generation in the upper 32 bits, arrived threads in the lower 32 */
+} barrier_shared_t;
+
+/**
+ * @brief Barrier counters owned by the kernel, mapped read-only by mapBarrier()
+ */
+typedef struct barrier_counters_t {
+    int parties;                /**< Parties of the counted barrier, 0 if unset */
+    int sleepers;               /**< Threads sleeping in the kernel */
+    int watchers;               /**< Eventfds registered on the barrier */
+} barrier_counters_t;
+
+
+/**
+ * @brief Sysfs attributes of a group accessed by the library
+ */
+typedef enum group_param_t {
+    PARAM_MAX_MESSAGE_SIZE,
+    PARAM_MAX_STORAGE_SIZE,
+    PARAM_CURRENT_STORAGE_SIZE,
+    PARAM_GARBAGE_COLLECTOR_RATIO,
+    PARAM_INCLUDE_STRUCT_SIZE,
+    PARAM_NUMBER
+} group_param_t;
+
 
 /**
  * @brief User-level handler of the thread-synch main device
@@ -138,7 +293,10 @@ typedef struct T_THREAD_GROUP {
     char *group_path;       /**< Path to the group file inside /dev directory*/
     size_t path_len;        /**< Length of the group path */
 
-    //struct pollfd param_watcher[PARAM_NUMBER];
+    barrier_shared_t *barrier;  /**< Mapped barrier state, NULL if not mapped */
+    const barrier_counters_t *barrier_counters; /**< Mapped barrier counters, valid when 'barrier' is */
+
+    int param_fd[PARAM_NUMBER]; /**< Sysfs attributes opened at their first use, -1 if not opened yet */
 
 }  thread_group_t;
 
@@ -149,23 +307,44 @@ static const char *group_default_path = "/dev/synch/group%d";
 
 
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 int initThreadSyncher(thread_synch_t *main_syncher);
+void releaseThreadSyncher(thread_synch_t *main_syncher);
 thread_group_t* installGroup(const group_t group_descriptor, thread_synch_t *main_synch);
+int uninstallGroup(thread_group_t *group, thread_synch_t *main_synch);
+void unloadGroup(thread_group_t *group);
+int installGroups(group_spec_t *specs, size_t count, thread_synch_t *main_synch);
 
 int readGroupInfo(thread_synch_t *main_syncher);
 
 
 int openGroup(thread_group_t* group);
+int openSharedGroup(thread_group_t* group);
 int readMessage(void *buffer, size_t len, thread_group_t *group);
 int writeMessage(const void *buffer, size_t len, thread_group_t *group);
+int readMessages(msg_t *messages, size_t count, thread_group_t *group);
+int writeMessages(const msg_t *messages, size_t count, thread_group_t *group);
+int nextMessageSize(thread_group_t *group, size_t *size);
 
 int setDelay(const long _delay, thread_group_t *group);
 int revokeDelay(thread_group_t *group);
 int cancelDelay(thread_group_t *group);
 
 int sleepOnBarrier(thread_group_t *group);
+int sleepOnBarrierTimeout(thread_group_t *group, const long timeout);
 int awakeBarrier(thread_group_t *group);
-
+int awakeBarrierN(thread_group_t *group, const unsigned int count);
+int arriveOnBarrier(thread_group_t *group);
+int setBarrierParties(thread_group_t *group, const unsigned int parties);
+int mapBarrier(thread_group_t *group);
+void unmapBarrier(thread_group_t *group);
+int registerBarrierEventfd(thread_group_t *group, const int event_fd);
+int unregisterBarrierEventfd(thread_group_t *group, const int event_fd);
+
+int getGroupStats(thread_group_t *group, group_snapshot_t *snapshot);
 unsigned long getCurrentStorageSize(thread_group_t *group);
 unsigned long getMaxStorageSize(thread_group_t *group);
 unsigned long getMaxMessageSize(thread_group_t *group);
@@ -188,4 +367,8 @@ int becomeOwner(thread_group_t *group);
 thread_group_t *loadGroupFromDescriptor(const group_t *descriptor, thread_synch_t *main_syncher);
 thread_group_t* loadGroupFromID(const int group_id);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif  //THREAD_SYNCH_H
\ No newline at end of file
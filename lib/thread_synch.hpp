@@ -0,0 +1,500 @@
+/**
+ * @file thread_synch.hpp
+ *
+ * @brief Header-only C++ layer over the thread-synch user-level library
+ *
+ * The C structures are owned by move-only handles: a Syncher releases the main
+ * device and a Group closes and deallocates its thread_group_t, so nothing has
+ * to be freed by hand. Messages are sent from and received into caller-owned
+ * byte spans, and errors are returned as Result values carrying the library's
+ * error codes.
+ *
+ * Every method is an inline forward to the C function of the same purpose: no
+ * heap allocation is done per message.
+ *
+ * @note Requires C++17, std::span is used when compiled as C++20
+ */
+
+#ifndef THREAD_SYNCH_HPP
+#define THREAD_SYNCH_HPP
+
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
+#include "thread_synch.h"
+
+
+namespace thread_synch {
+
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+
+template <typename T>
+using span = std::span<T>;
+
+#else
+
+/**
+ * @brief Minimal replacement of std::span for C++17
+ */
+template <typename T>
+class span {
+public:
+    constexpr span() noexcept = default;
+    constexpr span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    template <std::size_t N>
+    constexpr span(T (&array)[N]) noexcept : data_(array), size_(N) {}
+
+    template <typename U, std::size_t N, typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(std::array<U, N> &array) noexcept : data_(array.data()), size_(N) {}
+
+    template <typename U, std::size_t N, typename = std::enable_if_t<std::is_convertible_v<const U (*)[], T (*)[]>>>
+    constexpr span(const std::array<U, N> &array) noexcept : data_(array.data()), size_(N) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(const span<U> &other) noexcept : data_(other.data()), size_(other.size()) {}
+
+    constexpr T *data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr std::size_t size_bytes() const noexcept { return size_ * sizeof(T); }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T *begin() const noexcept { return data_; }
+    constexpr T *end() const noexcept { return data_ + size_; }
+    constexpr T &operator[](std::size_t i) const noexcept { return data_[i]; }
+
+    constexpr span first(std::size_t count) const noexcept { return span(data_, count); }
+
+private:
+    T *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+#endif
+
+/** @brief View of the bytes of any trivially copyable object */
+template <typename T>
+inline span<const std::byte> asBytes(const T &object) noexcept {
+    static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable objects can be sent");
+    return span<const std::byte>(reinterpret_cast<const std::byte*>(&object), sizeof(T));
+}
+
+
+/*------------------------------------------------------------------------------
+	Errors
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Error code returned by the C library
+ *
+ * 'code' is one of the library's error values (GROUP_CLOSED, TS_NOT_FOUND, ...)
+ * or NO_MSG_PRESENT when no message was available. Failed system calls made
+ * by the wrappers themselves are reported through fromErrno(): 'code' is then
+ * the errno value and isErrno() is true, since negated errno values overlap
+ * with the library's codes.
+ */
+class Error {
+public:
+    constexpr explicit Error(int code) noexcept : code_(code), errno_(false) {}
+
+    /** @brief Error of a failed system call*/
+    static constexpr Error fromErrno(int error) noexcept { return Error(error, true); }
+
+    constexpr int code() const noexcept { return code_; }
+    constexpr bool isErrno() const noexcept { return errno_; }
+
+    constexpr bool noMessage() const noexcept { return !errno_ && code_ == NO_MSG_PRESENT; }
+    constexpr bool groupClosed() const noexcept { return !errno_ && code_ == GROUP_CLOSED; }
+    constexpr bool unauthorized() const noexcept { return !errno_ && (code_ == UNAUTHORIZED || code_ == PERMISSION_ERR); }
+
+    const char *message() const noexcept {
+        if(errno_)
+            return std::strerror(code_);
+
+        switch(code_){
+            case NO_MSG_PRESENT:    return "no message present";
+            case ALLOC_ERR:         return "allocation error";
+            case USER_COPY_ERR:     return "user copy error";
+            case MSG_INVALID_FORMAT:return "invalid message format";
+            case MSG_SIZE_ERROR:    return "invalid message size";
+            case MEMORY_ERROR:      return "memory error";
+            case STORAGE_SIZE_ERR:  return "storage size exceeded";
+            case INVALID_CONFIG_ERR:return "invalid configuration";
+            case TS_NOT_FOUND:      return "main device not found";
+            case TS_OPEN_ERR:       return "unable to open the main device";
+            case UNAUTHORIZED:      return "unauthorized";
+            case PERMISSION_ERR:    return "permission denied";
+            case GROUP_CLOSED:      return "group closed";
+            case UNSUPPORTED_ERR:   return "not supported by the module";
+            default:                return "operation failed";
+        }
+    }
+
+    friend constexpr bool operator==(const Error &a, const Error &b) noexcept { return a.code_ == b.code_ && a.errno_ == b.errno_; }
+    friend constexpr bool operator!=(const Error &a, const Error &b) noexcept { return !(a == b); }
+
+private:
+    constexpr Error(int code, bool is_errno) noexcept : code_(code), errno_(is_errno) {}
+
+    int code_;
+    bool errno_;
+};
+
+
+/**
+ * @brief Value or error, with the interface of std::expected
+ */
+template <typename T>
+class Result {
+public:
+    Result(const T &value) : has_value_(true) { new (storage_) T(value); }
+    Result(T &&value) noexcept(std::is_nothrow_move_constructible_v<T>) : has_value_(true) { new (storage_) T(std::move(value)); }
+    Result(Error error) noexcept : has_value_(false), error_(error) {}
+
+    Result(Result &&other) noexcept(std::is_nothrow_move_constructible_v<T>) : has_value_(other.has_value_), error_(other.error_) {
+        if(has_value_)
+            new (storage_) T(std::move(*other));
+    }
+
+    Result(const Result&) = delete;
+    Result &operator=(const Result&) = delete;
+    Result &operator=(Result&&) = delete;
+
+    ~Result() {
+        if(has_value_)
+            (**this).~T();
+    }
+
+    constexpr bool has_value() const noexcept { return has_value_; }
+    constexpr explicit operator bool() const noexcept { return has_value_; }
+
+    T &operator*() & noexcept { return *std::launder(reinterpret_cast<T*>(storage_)); }
+    const T &operator*() const & noexcept { return *std::launder(reinterpret_cast<const T*>(storage_)); }
+    T &&operator*() && noexcept { return std::move(**this); }
+    T *operator->() noexcept { return &**this; }
+    const T *operator->() const noexcept { return &**this; }
+
+    T &value() & noexcept { return **this; }
+    const T &value() const & noexcept { return **this; }
+    T &&value() && noexcept { return std::move(**this); }
+
+    template <typename U>
+    T value_or(U &&fallback) const & { return has_value_ ? **this : static_cast<T>(std::forward<U>(fallback)); }
+
+    constexpr Error error() const noexcept { return error_; }
+
+private:
+    bool has_value_;
+    Error error_ = Error(0);
+    alignas(T) unsigned char storage_[sizeof(T)];
+};
+
+/** @brief Result of operations returning no value*/
+template <>
+class Result<void> {
+public:
+    constexpr Result() noexcept : error_(0) {}
+    constexpr Result(Error error) noexcept : error_(error == Error(0) ? Error(-1) : error) {}
+
+    constexpr bool has_value() const noexcept { return error_ == Error(0); }
+    constexpr explicit operator bool() const noexcept { return has_value(); }
+
+    constexpr Error error() const noexcept { return error_; }
+
+private:
+    Error error_;
+};
+
+namespace detail {
+
+/** @brief Map a C return value, negative on error, to a Result<void>*/
+inline Result<void> check(const int ret) noexcept {
+    if(ret < 0)
+        return Error(ret);
+    return {};
+}
+
+} //namespace detail
+
+
+/*------------------------------------------------------------------------------
+	Groups
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief A message received into a caller-owned buffer
+ */
+struct Message {
+    span<std::byte> data;       /**< Received bytes, a prefix of the provided buffer*/
+    pid_t author;               /**< Author of the message, see readMessages()*/
+};
+
+
+/**
+ * @brief Move-only owner of a thread_group_t structure
+ *
+ * The structure is released with unloadGroup() when the handle is destroyed,
+ * which also closes the group if it is open.
+ */
+class Group {
+public:
+    /** @brief Take the ownership of a structure returned by the C library*/
+    explicit Group(thread_group_t *group) noexcept : group_(group) {}
+
+    Group(Group &&other) noexcept : group_(std::exchange(other.group_, nullptr)) {}
+
+    Group &operator=(Group &&other) noexcept {
+        if(this != &other){
+            unloadGroup(group_);
+            group_ = std::exchange(other.group_, nullptr);
+        }
+        return *this;
+    }
+
+    Group(const Group&) = delete;
+    Group &operator=(const Group&) = delete;
+
+    ~Group() { unloadGroup(group_); }
+
+    /** @brief Load an installed group given its ID, the group is opened*/
+    static Result<Group> load(const int group_id) noexcept {
+        thread_group_t *group = loadGroupFromID(group_id);
+
+        if(!group)
+            return Error(-1);
+        return Group(group);
+    }
+
+    thread_group_t *native() const noexcept { return group_; }
+    unsigned int id() const noexcept { return group_->group_id; }
+    bool isOpen() const noexcept { return group_ && group_->file_descriptor != -1; }
+
+    /** @brief Give back the structure to the C library*/
+    thread_group_t *release() noexcept { return std::exchange(group_, nullptr); }
+
+
+    Result<void> open() noexcept { return detail::check(openGroup(group_)); }
+    Result<void> openShared() noexcept { return detail::check(openSharedGroup(group_)); }
+
+
+    /** @brief Write a message*/
+    Result<void> send(span<const std::byte> message) noexcept {
+        return detail::check(writeMessage(message.data(), message.size(), group_));
+    }
+
+    /**
+     * @brief Write several messages with a single syscall
+     * @return The number of messages written
+     */
+    Result<std::size_t> send(span<const msg_t> messages) noexcept {
+        int ret = writeMessages(messages.data(), messages.size(), group_);
+
+        if(ret < 0)
+            return Error(ret);
+        return static_cast<std::size_t>(ret);
+    }
+
+    /**
+     * @brief Receive a message into a caller-owned buffer
+     *
+     * @return The received message, or an error for which Error::noMessage()
+     *          is true if no message was available
+     *
+     * @note A message longer than 'buffer' is left in the group and reported
+     *          as MSG_SIZE_ERROR, see nextMessageSize()
+     */
+    Result<Message> receive(span<std::byte> buffer) noexcept {
+        msg_t message = {0, buffer.data(), buffer.size()};
+        int ret = readMessages(&message, 1, group_);
+
+        if(ret < 0)
+            return Error(ret);
+        if(ret == 0)
+            return Error(NO_MSG_PRESENT);
+
+        return Message{buffer.first(message.size), message.author};
+    }
+
+    /**
+     * @brief Receive several messages with a single syscall, see readMessages()
+     * @return The number of messages received, 0 if none was available
+     */
+    Result<std::size_t> receive(span<msg_t> messages) noexcept {
+        int ret = readMessages(messages.data(), messages.size(), group_);
+
+        if(ret < 0)
+            return Error(ret);
+        return static_cast<std::size_t>(ret);
+    }
+
+
+    /**
+     * @brief Size of the next message, without reading it
+     * @return The size, or an error for which Error::noMessage() is true if
+     *          no message was available
+     */
+    Result<std::size_t> nextMessageSize() noexcept {
+        std::size_t size;
+        int ret = ::nextMessageSize(group_, &size);
+
+        if(ret == NO_MSG_PRESENT)
+            return Error(NO_MSG_PRESENT);
+        if(ret < 0)
+            return Error(ret);
+        return size;
+    }
+
+
+    Result<void> setDelay(const long delay) noexcept { return detail::check(::setDelay(delay, group_)); }
+    Result<void> revokeDelay() noexcept { return detail::check(::revokeDelay(group_)); }
+    Result<void> cancelDelay() noexcept { return detail::check(::cancelDelay(group_)); }
+
+    Result<void> sleepOnBarrier() noexcept { return detail::check(::sleepOnBarrier(group_)); }
+    Result<void> awakeBarrier() noexcept { return detail::check(::awakeBarrier(group_)); }
+
+    /** @return true for the thread that released the barrier*/
+    Result<bool> arriveOnBarrier() noexcept {
+        int ret = ::arriveOnBarrier(group_);
+
+        if(ret < 0)
+            return Error(ret);
+        return ret == BARRIER_SERIAL_THREAD;
+    }
+
+    Result<group_snapshot_t> stats() noexcept {
+        group_snapshot_t snapshot;
+        int ret = getGroupStats(group_, &snapshot);
+
+        if(ret < 0)
+            return Error(ret);
+        return snapshot;
+    }
+
+    Result<void> setMaxMessageSize(const unsigned long value) noexcept { return detail::check(::setMaxMessageSize(group_, value)); }
+    Result<void> setMaxStorageSize(const unsigned long value) noexcept { return detail::check(::setMaxStorageSize(group_, value)); }
+    Result<void> setGarbageCollectorRatio(const unsigned long value) noexcept { return detail::check(::setGarbageCollectorRatio(group_, value)); }
+
+    Result<void> enableStrictMode() noexcept { return detail::check(::enableStrictMode(group_)); }
+    Result<void> disableStrictMode() noexcept { return detail::check(::disableStrictMode(group_)); }
+    Result<void> changeOwner(const uid_t owner) noexcept { return detail::check(::changeOwner(group_, owner)); }
+
+private:
+    thread_group_t *group_;
+};
+
+
+/**
+ * @brief Receive buffer owned by the caller and reused for every message
+ *
+ * The storage is part of the object, so it can live on the stack or inside
+ * the consumer's state and no allocation is done per message.
+ */
+template <std::size_t Size>
+class ReceiveBuffer {
+public:
+    /** @brief Receive a message, valid until the next call*/
+    Result<Message> receive(Group &group) noexcept { return group.receive(bytes()); }
+
+    span<std::byte> bytes() noexcept { return span<std::byte>(buffer_); }
+
+    constexpr std::size_t capacity() const noexcept { return Size; }
+
+private:
+    std::array<std::byte, Size> buffer_;
+};
+
+
+/*------------------------------------------------------------------------------
+	Main device
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Move-only owner of the main thread-synch device
+ */
+class Syncher {
+public:
+    /** @brief Open the main device*/
+    static Result<Syncher> open() noexcept {
+        Syncher syncher;
+        int ret = initThreadSyncher(&syncher.syncher_);
+
+        if(ret < 0)
+            return Error(ret);
+        return syncher;
+    }
+
+    Syncher(Syncher &&other) noexcept : syncher_(std::exchange(other.syncher_, thread_synch_t{})) {}
+
+    Syncher &operator=(Syncher &&other) noexcept {
+        if(this != &other){
+            releaseThreadSyncher(&syncher_);
+            syncher_ = std::exchange(other.syncher_, thread_synch_t{});
+        }
+        return *this;
+    }
+
+    Syncher(const Syncher&) = delete;
+    Syncher &operator=(const Syncher&) = delete;
+
+    ~Syncher() { releaseThreadSyncher(&syncher_); }
+
+    thread_synch_t *native() noexcept { return &syncher_; }
+
+    /** @brief Install a new group, the returned group is not opened*/
+    Result<Group> install(std::string_view name) {
+        std::string group_name(name);
+        group_t descriptor = {group_name.data(), static_cast<ssize_t>(group_name.size())};
+        thread_group_t *group = installGroup(descriptor, &syncher_);
+
+        if(!group)
+            return Error(-1);
+        return Group(group);
+    }
+
+    /** @brief Load an installed group given its name, the group is not opened*/
+    Result<Group> load(std::string_view name) {
+        std::string group_name(name);
+        group_t descriptor = {group_name.data(), static_cast<ssize_t>(group_name.size())};
+        thread_group_t *group = loadGroupFromDescriptor(&descriptor, &syncher_);
+
+        if(!group)
+            return Error(-1);
+        return Group(group);
+    }
+
+    /**
+     * @brief Uninstall a group
+     *
+     * On success the group's handle is released, otherwise it is left untouched
+     */
+    Result<void> uninstall(Group &group) noexcept {
+        if(uninstallGroup(group.native(), &syncher_) < 0)
+            return Error(-1);
+
+        group.release();    //Already deallocated by 'uninstallGroup'
+        return {};
+    }
+
+private:
+    Syncher() noexcept : syncher_{} {}
+
+    thread_synch_t syncher_;
+};
+
+
+} //namespace thread_synch
+
+
+#endif  //THREAD_SYNCH_HPP
@@ -0,0 +1,633 @@
+/**
+ * @file thread_synch_coro.hpp
+ *
+ * @brief C++20 coroutines over group devices
+ *
+ * An Executor multiplexes any number of coroutines on the thread calling
+ * Executor::run(): a coroutine that has to wait for a message or for a barrier
+ * release is suspended and resumed from an epoll loop when its group becomes
+ * readable, instead of blocking an OS thread in the kernel.
+ *
+ *      Task consume(AsyncGroup &group){
+ *          ReceiveBuffer<256> buffer;
+ *          for(;;){
+ *              auto msg = co_await group.receive(buffer);
+ *              if(!msg)
+ *                  co_return;
+ *              ...
+ *          }
+ *      }
+ *
+ * Group devices report readiness through their 'poll' file operation, barrier
+ * releases through an eventfd registered with registerBarrierEventfd().
+ *
+ * @note Requires C++20. The executor is single-threaded: all the methods,
+ *          except Executor::stop(), must be called by the thread running it
+ */
+
+#ifndef THREAD_SYNCH_CORO_HPP
+#define THREAD_SYNCH_CORO_HPP
+
+
+#if __cplusplus < 202002L || !__has_include(<coroutine>)
+#error "thread_synch_coro.hpp requires C++20 coroutines"
+#endif
+
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "thread_synch.hpp"
+
+
+namespace thread_synch {
+
+
+/*------------------------------------------------------------------------------
+	Tasks
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Coroutine started by an Executor
+ *
+ * A task is created suspended and runs once passed to Executor::spawn(). Its
+ * frame is destroyed when it returns; a task that is never spawned is
+ * destroyed with its handle.
+ *
+ * @note An exception escaping a task terminates the program
+ */
+class Task {
+public:
+    struct promise_type {
+        Task get_return_object() noexcept { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+    Task(const Task&) = delete;
+    Task &operator=(const Task&) = delete;
+    Task &operator=(Task&&) = delete;
+
+    ~Task() {
+        if(handle_)
+            handle_.destroy();
+    }
+
+    /** @brief Give the coroutine to its executor*/
+    std::coroutine_handle<> release() noexcept { return std::exchange(handle_, nullptr); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+
+/*------------------------------------------------------------------------------
+	Executor
+------------------------------------------------------------------------------*/
+
+class AsyncGroup;
+
+/**
+ * @brief Epoll loop resuming the coroutines waiting on group devices
+ *
+ * Each file watched by the executor is a Source with a FIFO of suspended
+ * awaiters. When the file becomes readable the awaiters are asked, in order,
+ * to complete their operation: those that succeed are resumed, the others
+ * keep waiting. Input is requested to epoll only while a source has awaiters.
+ */
+class Executor {
+public:
+    static constexpr int max_events = 64;   /**< Readiness events handled by each iteration of run()*/
+
+    /**
+     * @brief Operation suspended on a source
+     *
+     * 'complete' retries the operation and returns true once it has a result,
+     * either a value or an error
+     */
+    struct Waiter {
+        bool (*complete)(Waiter *waiter) noexcept;
+        std::coroutine_handle<> handle;
+        Waiter *next = nullptr;
+    };
+
+    /**
+     * @brief File watched by the executor
+     */
+    struct Source {
+        int fd;
+        bool eventfd;               /**< Drained before completing the awaiters*/
+        bool in_order;              /**< Stop at the first awaiter that cannot complete*/
+        uint32_t events = 0;        /**< Events currently requested to epoll*/
+        Waiter *head = nullptr;     /**< FIFO of suspended awaiters*/
+        Waiter *tail = nullptr;
+    };
+
+    /** @brief Create an executor with no sources*/
+    static Result<Executor> create() noexcept {
+        struct epoll_event event;
+        Executor executor;
+
+        executor.epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if(executor.epoll_fd_ < 0)
+            return Error::fromErrno(errno);
+
+        executor.wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(executor.wake_fd_ < 0)
+            return Error::fromErrno(errno);
+
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;   //Identifies the wake-up eventfd
+
+        if(epoll_ctl(executor.epoll_fd_, EPOLL_CTL_ADD, executor.wake_fd_, &event) < 0)
+            return Error::fromErrno(errno);
+
+        return executor;
+    }
+
+    Executor(Executor &&other) noexcept :
+        epoll_fd_(std::exchange(other.epoll_fd_, -1)), wake_fd_(std::exchange(other.wake_fd_, -1)),
+        sources_(std::move(other.sources_)), ready_(std::move(other.ready_)), pending_(other.pending_) {}
+
+    Executor(const Executor&) = delete;
+    Executor &operator=(const Executor&) = delete;
+    Executor &operator=(Executor&&) = delete;
+
+    /**
+     * @brief Close the executor
+     *
+     * Spawned tasks that did not start are destroyed, suspended ones are leaked
+     */
+    ~Executor() {
+        for(std::coroutine_handle<> handle : ready_)
+            handle.destroy();
+
+        if(wake_fd_ >= 0)
+            close(wake_fd_);
+        if(epoll_fd_ >= 0)
+            close(epoll_fd_);
+    }
+
+    /**
+     * @brief Serve a group from this executor
+     *
+     * @param[in] &group An opened group, it must outlive the returned object
+     *
+     * @note Messages are read on behalf of the thread running the executor,
+     *          unless the group was opened with Group::openShared()
+     */
+    Result<AsyncGroup> attach(Group &group);
+
+    /** @brief Schedule a task, it starts at the next iteration of run()*/
+    void spawn(Task task) {
+        ready_.push_back(task.release());
+    }
+
+    /**
+     * @brief Run the spawned tasks until all of them return or stop() is called
+     *
+     * @return An error if waiting for events failed
+     */
+    Result<void> run() {
+        struct epoll_event events[max_events];
+        std::vector<std::coroutine_handle<>> running;
+        uint64_t counter;
+        int ready;
+        int i;
+
+        while(!stopped_){
+            //Coroutines resumed here can spawn tasks or be made ready again
+            running.swap(ready_);
+            for(std::coroutine_handle<> handle : running)
+                handle.resume();
+            running.clear();
+
+            if(!ready_.empty())
+                continue;
+            if(pending_ == 0)
+                break;
+
+            ready = epoll_wait(epoll_fd_, events, max_events, -1);
+            if(ready < 0){
+                if(errno == EINTR)
+                    continue;
+                return Error::fromErrno(errno);
+            }
+
+            for(i = 0; i < ready; i++){
+                if(!events[i].data.ptr){
+                    if(read(wake_fd_, &counter, sizeof(uint64_t)) < 0 && errno != EAGAIN)
+                        return Error::fromErrno(errno);
+                    continue;
+                }
+
+                dispatch(static_cast<Source*>(events[i].data.ptr), events[i].events);
+            }
+        }
+
+        stopped_ = false;
+
+        return {};
+    }
+
+    /**
+     * @brief Make run() return after the current iteration
+     *
+     * @note It is the only method that can be called from any thread
+     */
+    void stop() noexcept {
+        uint64_t one = 1;
+
+        stopped_ = true;
+
+        if(write(wake_fd_, &one, sizeof(uint64_t)) < 0)
+            return;
+    }
+
+    /** @brief Number of coroutines suspended on a source*/
+    std::size_t pending() const noexcept { return pending_; }
+
+    /** @brief Start watching a file, with no events requested*/
+    Result<Source*> addSource(const int fd, const bool eventfd, const bool in_order) {
+        struct epoll_event event;
+        auto source = std::make_unique<Source>(Source{fd, eventfd, in_order});
+
+        event.events = 0;
+        event.data.ptr = source.get();
+
+        if(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0)
+            return Error::fromErrno(errno);
+
+        sources_.push_back(std::move(source));
+        return sources_.back().get();
+    }
+
+    /**
+     * @brief Stop watching a file
+     *
+     * @note No coroutine must be suspended on the source
+     */
+    void removeSource(Source *source) noexcept {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, source->fd, nullptr);
+
+        for(auto it = sources_.begin(); it != sources_.end(); ++it){
+            if(it->get() == source){
+                sources_.erase(it);
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Suspend an awaiter on a source until it can complete
+     *
+     * @return false if input cannot be requested to epoll: the awaiter must
+     *          not suspend
+     */
+    bool wait(Source *source, Waiter *waiter) noexcept {
+        if(!updateEvents(source, EPOLLIN))
+            return false;
+
+        waiter->next = nullptr;
+        if(source->tail)
+            source->tail->next = waiter;
+        else
+            source->head = waiter;
+        source->tail = waiter;
+
+        pending_++;
+        return true;
+    }
+
+private:
+    Executor() noexcept = default;
+
+    bool updateEvents(Source *source, const uint32_t events) noexcept {
+        struct epoll_event event;
+
+        if(source->events == events)
+            return true;
+
+        event.events = events;
+        event.data.ptr = source;
+
+        if(epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, source->fd, &event) < 0)
+            return false;
+
+        source->events = events;
+        return true;
+    }
+
+    /**
+     * @brief Complete the awaiters of a ready source and schedule their coroutines
+     */
+    void dispatch(Source *source, const uint32_t events) {
+        Waiter **cursor = &source->head;
+        Waiter *waiter;
+        uint64_t counter;
+
+        if(source->eventfd && read(source->fd, &counter, sizeof(uint64_t)) < 0 && errno != EAGAIN)
+            return;
+
+        source->tail = nullptr;
+
+        while((waiter = *cursor) != nullptr){
+            if(waiter->complete(waiter)){
+                *cursor = waiter->next;
+                pending_--;
+                ready_.push_back(waiter->handle);
+                continue;
+            }
+
+            //The next readers would find the group empty as well
+            if(source->in_order && !(events & (EPOLLERR | EPOLLHUP))){
+                while(waiter->next)
+                    waiter = waiter->next;
+                source->tail = waiter;
+                break;
+            }
+
+            source->tail = waiter;
+            cursor = &waiter->next;
+        }
+
+        //Hang-ups are reported regardless of the requested events
+        if(!source->head && updateEvents(source, 0) && (events & (EPOLLERR | EPOLLHUP)))
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, source->fd, nullptr);
+    }
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;                  /**< Eventfd used by stop()*/
+
+    std::vector<std::unique_ptr<Source>> sources_;
+    std::vector<std::coroutine_handle<>> ready_;    /**< Coroutines to resume at the next iteration*/
+    std::size_t pending_ = 0;
+
+    volatile bool stopped_ = false;
+};
+
+
+/*------------------------------------------------------------------------------
+	Awaitables
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Awaitable reading one message from a group
+ *
+ * The read is first tried without suspending; if no message is present the
+ * coroutine waits for the group to become readable.
+ */
+class ReceiveAwaiter : private Executor::Waiter {
+public:
+    ReceiveAwaiter(Executor &executor, Executor::Source *source, Group &group, span<std::byte> buffer) noexcept :
+        Executor::Waiter{&ReceiveAwaiter::retry, nullptr}, executor_(executor), source_(source), group_(group), buffer_(buffer) {}
+
+    bool await_ready() noexcept {
+        return tryRead();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        this->handle = handle;
+
+        if(!executor_.wait(source_, this)){
+            error_ = Error::fromErrno(errno);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @return The received message, a prefix of the buffer, or an error if
+     *          the read failed or the group was uninstalled. A message longer
+     *          than the buffer is left in the group and reported as MSG_SIZE_ERROR
+     */
+    Result<Message> await_resume() noexcept {
+        if(error_ != Error(0))
+            return error_;
+        if(ret_ < 0)
+            return Error(ret_);
+        return Message{buffer_.first(message_.size), message_.author};
+    }
+
+private:
+    bool tryRead() noexcept {
+        message_ = {0, buffer_.data(), buffer_.size()};
+        ret_ = readMessages(&message_, 1, group_.native());
+
+        return ret_ != 0;
+    }
+
+    static bool retry(Executor::Waiter *waiter) noexcept {
+        return static_cast<ReceiveAwaiter*>(waiter)->tryRead();
+    }
+
+    Executor &executor_;
+    Executor::Source *source_;
+    Group &group_;
+    span<std::byte> buffer_;
+
+    msg_t message_;
+    int ret_ = 0;
+    Error error_ = Error(0);    /**< Failure of the wait, before any read*/
+};
+
+/**
+ * @brief Awaitable writing one message to a group
+ *
+ * Writes to a group device never block, so the message is written without
+ * suspending the coroutine
+ */
+class SendAwaiter {
+public:
+    SendAwaiter(Group &group, span<const std::byte> message) noexcept : group_(group), message_(message) {}
+
+    constexpr bool await_ready() const noexcept { return true; }
+    void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+    Result<void> await_resume() noexcept { return group_.send(message_); }
+
+private:
+    Group &group_;
+    span<const std::byte> message_;
+};
+
+/**
+ * @brief Awaitable waiting for the next release of a group's barrier
+ *
+ * The generation of the mapped barrier is sampled when the awaiter is
+ * created, so a release happening before the coroutine suspends is not lost.
+ */
+class BarrierAwaiter : private Executor::Waiter {
+public:
+    BarrierAwaiter(Executor &executor, Executor::Source *source, Group &group, const Error error) noexcept :
+        Executor::Waiter{&BarrierAwaiter::retry, nullptr}, executor_(executor), source_(source), barrier_(nullptr), error_(error) {
+        if(error_ == Error(0)){
+            barrier_ = group.native()->barrier;
+            generation_ = BARRIER_GENERATION(__atomic_load_n(&barrier_->state, __ATOMIC_ACQUIRE));
+        }
+    }
+
+    bool await_ready() noexcept {
+        return error_ != Error(0) || released();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        this->handle = handle;
+
+        if(!executor_.wait(source_, this)){
+            error_ = Error::fromErrno(errno);
+            return false;
+        }
+        return true;
+    }
+
+    Result<void> await_resume() const noexcept {
+        if(error_ != Error(0))
+            return error_;
+        return {};
+    }
+
+private:
+    bool released() const noexcept {
+        return BARRIER_GENERATION(__atomic_load_n(&barrier_->state, __ATOMIC_ACQUIRE)) != generation_;
+    }
+
+    static bool retry(Executor::Waiter *waiter) noexcept {
+        return static_cast<BarrierAwaiter*>(waiter)->released();
+    }
+
+    Executor &executor_;
+    Executor::Source *source_;
+    barrier_shared_t *barrier_;
+    uint32_t generation_ = 0;
+    Error error_;
+};
+
+
+/*------------------------------------------------------------------------------
+	Groups
+------------------------------------------------------------------------------*/
+
+/**
+ * @brief Group served by an Executor, returned by Executor::attach()
+ *
+ * @note No coroutine must be suspended on the group when it is destroyed
+ */
+class AsyncGroup {
+public:
+    AsyncGroup(AsyncGroup &&other) noexcept :
+        executor_(other.executor_), group_(other.group_),
+        source_(std::exchange(other.source_, nullptr)), barrier_(std::exchange(other.barrier_, nullptr)) {}
+
+    AsyncGroup(const AsyncGroup&) = delete;
+    AsyncGroup &operator=(const AsyncGroup&) = delete;
+    AsyncGroup &operator=(AsyncGroup&&) = delete;
+
+    ~AsyncGroup() {
+        if(barrier_){
+            unregisterBarrierEventfd(group_->native(), barrier_->fd);
+            close(barrier_->fd);
+            executor_->removeSource(barrier_);
+        }
+        if(source_)
+            executor_->removeSource(source_);
+    }
+
+    Group &group() const noexcept { return *group_; }
+
+    /** @brief Receive a message, suspending until one is present*/
+    ReceiveAwaiter receive(span<std::byte> buffer) noexcept {
+        return ReceiveAwaiter(*executor_, source_, *group_, buffer);
+    }
+
+    template <std::size_t Size>
+    ReceiveAwaiter receive(ReceiveBuffer<Size> &buffer) noexcept {
+        return receive(buffer.bytes());
+    }
+
+    SendAwaiter send(span<const std::byte> message) noexcept {
+        return SendAwaiter(*group_, message);
+    }
+
+    /**
+     * @brief Wait for the next release of the group's barrier
+     *
+     * The first call maps the barrier and registers an eventfd on it
+     */
+    BarrierAwaiter barrier() {
+        Error error = barrier_ ? Error(0) : watchBarrier();
+
+        return BarrierAwaiter(*executor_, barrier_, *group_, error);
+    }
+
+private:
+    friend class Executor;
+
+    AsyncGroup(Executor &executor, Group &group, Executor::Source *source) noexcept :
+        executor_(&executor), group_(&group), source_(source), barrier_(nullptr) {}
+
+    Error watchBarrier() {
+        int event_fd;
+        int ret;
+
+        if(!group_->native()->barrier && (ret = mapBarrier(group_->native())) < 0)
+            return Error(ret);
+
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(event_fd < 0)
+            return Error::fromErrno(errno);
+
+        if((ret = registerBarrierEventfd(group_->native(), event_fd)) < 0){
+            close(event_fd);
+            return Error(ret);
+        }
+
+        auto source = executor_->addSource(event_fd, true, false);
+        if(!source){
+            unregisterBarrierEventfd(group_->native(), event_fd);
+            close(event_fd);
+            return source.error();
+        }
+
+        barrier_ = *source;
+        return Error(0);
+    }
+
+    Executor *executor_;
+    Group *group_;
+    Executor::Source *source_;
+    Executor::Source *barrier_;     /**< Barrier eventfd, NULL until barrier() is awaited*/
+};
+
+
+inline Result<AsyncGroup> Executor::attach(Group &group) {
+    if(!group.isOpen())
+        return Error(GROUP_CLOSED);
+
+    auto source = addSource(group.native()->file_descriptor, false, true);
+    if(!source)
+        return source.error();
+
+    return AsyncGroup(*this, group, *source);
+}
+
+
+} //namespace thread_synch
+
+
+#endif  //THREAD_SYNCH_CORO_HPP
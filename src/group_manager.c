@@ -1,9 +1,13 @@
 #include "group_manager.h"
+#include "synch_trace.h"
 
 // Global Variables
 struct class *group_device_class;
 EXPORT_SYMBOL(group_device_class);
 
+static dev_t group_region;          /**< First device number of the group devices region */
+static struct cdev group_cdev;      /**< Character device shared by all groups */
+
 
 int copy_group_t_to_user(__user group_t *user_group, group_t *kern_group);
 
@@ -19,7 +23,7 @@ int copy_group_t_to_user(__user group_t *user_group, group_t *kern_group);
 int installGroupClass(){
 
 	//Create "group_sync" on the first device creation
-    pr_debug("Group class not exists, creating...");
+    logGroup("Group class not exists, creating...");
     group_device_class = class_create(THIS_MODULE, GROUP_CLASS_NAME);
 
 
@@ -32,7 +36,7 @@ int installGroupClass(){
     if(IS_ERR(group_device_class)){
 
         if(PTR_ERR(group_device_class) == -EEXIST){
-            pr_info("'group_sync' class already exists, skipping class creation");
+            logGroup("'group_sync' class already exists, skipping class creation");
             return CLASS_EXISTS;
         }else{
             pr_err("Unable to create 'group_sync' class");
@@ -44,6 +48,50 @@ int installGroupClass(){
     return 0;
 }
 
+/**
+ * @brief Allocate the char device region shared by all the group devices
+ * 
+ * The region is allocated once at module load: the minor of a group device
+ * is its ID, and 'openGroup' maps it back to the group through the IDR. In 
+ * this way installing a group does not reserve any additional major number.
+ * 
+ * @retval 0 on success
+ * @retval CHDEV_ALLOC_ERR if the region cannot be allocated
+ * @retval CDEV_ALLOC_ERR if the char device cannot be added
+ */
+int registerGroupRegion(void){
+    int err;
+
+    err = alloc_chrdev_region(&group_region, 0, GROUP_MAX_MINORS, GROUP_CLASS_NAME);
+
+    if(err < 0){
+        pr_err("Unable to allocate the group devices region: %d", err);
+        return CHDEV_ALLOC_ERR;
+    }
+
+    cdev_init(&group_cdev, &group_operation);
+    group_cdev.owner = THIS_MODULE;
+
+    err = cdev_add(&group_cdev, group_region, GROUP_MAX_MINORS);
+    if(err < 0){
+        pr_err("Unable to add group char dev. Error %d", err);
+        unregister_chrdev_region(group_region, GROUP_MAX_MINORS);
+        return CDEV_ALLOC_ERR;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Release the char device region shared by all the group devices
+ * 
+ * @return nothing
+ */
+void unregisterGroupRegion(void){
+    cdev_del(&group_cdev);
+    unregister_chrdev_region(group_region, GROUP_MAX_MINORS);
+}
+
 /**
  * @brief Checks if the garbage collector is enabled 
  * 
@@ -77,15 +125,16 @@ bool checkGarbageRatio(group_data *grp_data){
 
     u_long curr_storage;
     u_long max_storage;
+    u64 held;
 
     manager = grp_data->msg_manager;
 
-    down_read(&manager->config_lock);
+    held = statsDownRead(grp_data, LOCK_CONFIG, &manager->config_lock);
 
         curr_storage = manager->curr_storage_size;
         max_storage = manager->max_storage_size;
 
-    up_read(&manager->config_lock);
+    statsUpRead(grp_data, LOCK_CONFIG, &manager->config_lock, held);
 
     if(curr_storage > max_storage){
         printk(KERN_ERR "Inconsistent group's size (current > max)");
@@ -98,8 +147,8 @@ bool checkGarbageRatio(group_data *grp_data){
     current_ratio = curr_storage * 10;
     current_ratio = current_ratio / max_storage;
 
-    pr_debug("Garbage ratio: %hu", ratio);
-    pr_debug("Current ratio: %hu", current_ratio);  
+    logGc("Garbage ratio: %hu", ratio);
+    logGc("Current ratio: %hu", current_ratio);  
 
     if(current_ratio > ratio)
         return true;
@@ -127,8 +176,8 @@ bool isOwner(group_data *grp_data){
     down_read(&grp_data->owner_lock);
 
             current_owner = grp_data->owner;
-            pr_debug("Current owner: %d", current_owner);
-            pr_debug("Current user: %d", current_uid().val);
+            logGroup("Current owner: %d", current_owner);
+            logGroup("Current user: %d", current_uid().val);
             if(current_uid().val == current_owner){
                     ret = true;
             }else{
@@ -176,8 +225,8 @@ int changeOwner(group_data *grp_data, uid_t new_owner){
     up_write(&grp_data->owner_lock);
 /*
     if(ret == 0){
-        pr_debug("New Owner UID: %u", new_owner);
-        pr_debug("Current owner UID: %u", current_owner);
+        logGroup("New Owner UID: %u", new_owner);
+        logGroup("Current owner UID: %u", current_owner);
     }
 */
 
@@ -197,7 +246,7 @@ int changeOwner(group_data *grp_data, uid_t new_owner){
 int setStrictMode(group_data *grp_data, const bool enabled){
 
     if(isOwner(grp_data)){
-        pr_debug("Authorized to change strict mode to %d", enabled);
+        logGroup("Authorized to change strict mode to %d", enabled);
         if(enabled)
             grp_data->flags.strict_mode = 1;
         else
@@ -220,6 +269,7 @@ int setStrictMode(group_data *grp_data, const bool enabled){
 inline void initParticipants(group_data *grp_data){
     INIT_LIST_HEAD(&grp_data->active_members);
     atomic_set(&grp_data->members_count, 0);
+    atomic_set(&grp_data->handle_keys, 0);
     init_rwsem(&grp_data->member_lock);
 }
 
@@ -257,140 +307,242 @@ int removeParticipant(struct list_head *participants, pid_t _pid){
     return NODE_NOT_FOUND;
 }
 
+/**
+ * @brief Turn an open file of a group into a shared handle
+ * @param [in] filep The open file of the group device
+ * 
+ * The member added by 'openGroup' is moved to a key owned by the file, then
+ * every thread using the file reads and writes on behalf of that member. 
+ * Keys are negative, so they never match the PID of a thread.
+ * 
+ * @retval 0 on success, or if the file is already a shared handle
+ * @retval NODE_NOT_FOUND if the member of the file is not in the list
+ * 
+ * @note Messages already read through the file are not remembered by the new
+ *      key, the file should be shared right after opening the group
+ */
+static int shareHandle(struct file *filep){
+    group_file_t *gfile = filep->private_data;
+    group_data *grp_data = gfile->group;
+    group_members_t *entry;
+    int ret = NODE_NOT_FOUND;
+    u64 held;
+
+    held = statsDownWrite(grp_data, LOCK_MEMBER, &grp_data->member_lock);
+
+        if(gfile->shared){
+            ret = 0;
+            goto unlock;
+        }
+
+        list_for_each_entry(entry, &grp_data->active_members, list){
+            if(entry->pid == gfile->member){
+                entry->pid = -atomic_inc_return(&grp_data->handle_keys);
+
+                //Pairs with the acquire of 'fileMember': 'shared' is seen only with the new key
+                WRITE_ONCE(gfile->member, entry->pid);
+                smp_store_release(&gfile->shared, true);
+                ret = 0;
+                break;
+            }
+        }
+
+    unlock:
+    statsUpWrite(grp_data, LOCK_MEMBER, &grp_data->member_lock, held);
+
+    logGroup("File of group %d shared as member %d", grp_data->group_id, gfile->member);
+
+    return ret;
+}
+
 
 /**
- *  @brief register a group device 
- *  @param [in] grp_data    The group data descriptor
- *  @param [in] parent      device parent (usually 'main_device')
+ * @brief Take a reference on a group
  * 
- *  @retval 0 on success
- *  @retval CHDEV_ALLOC_ERR If the char device allocation fails
- *  @retval ALLOC_ERR If some memory allocation fails
- *  @retval DEV_CREATION_ERR If the char device creation fails
+ * @param[in] grp_data The group to reference
+ * 
+ * @retval true if the reference was taken
+ * @retval false if the group is being released
+ * 
+ * @note Can be called inside an RCU read-side critical section
  */
-int registerGroupDevice(group_data *grp_data, struct device* parent){
+bool getGroup(group_data *grp_data){
+    return kref_get_unless_zero(&grp_data->refcount);
+}
 
-    int err;
-    char device_name[DEVICE_NAME_SIZE];    //Device name buffer
-    int ret = 0;    //Return value
+/**
+ * @brief RCU callback that deallocates a group structure
+ * 
+ * @param[in] head The 'rcu' member of the group to free
+ */
+static void freeGroupRcu(struct rcu_head *head){
+    group_data *grp_data = container_of(head, group_data, rcu);
 
+    kfree(grp_data->descriptor.group_name);
+    kfree(grp_data);
+}
 
-    snprintf(device_name, DEVICE_NAME_SIZE, "synch!group%d", grp_data->group_id);
-    pr_debug("Device name: %s", device_name);
+/**
+ * @brief Called when the last reference on a group is dropped
+ * 
+ * At this point no file is open on the group and no delayed message is
+ * pending, so the message subsystem can be released. Lock-free lookups may
+ * still be reading the structure (e.g. comparing its name), so the 
+ * deallocation of 'group_data' is deferred after a grace period.
+ */
+static void releaseGroupData(struct kref *ref){
+    group_data *grp_data = container_of(ref, group_data, refcount);
+    struct list_head *cursor, *temp;
 
+    logGroup("Releasing 'group%d' structure", grp_data->group_id);
 
-    //Allocate Device Major/Minor
-    err = alloc_chrdev_region(&grp_data->deviceID, 1, GROUP_MAX_MINORS, device_name);
+    //Participants and garbage collector are initialized with the message manager
+    if(grp_data->msg_manager){
+        cancel_work_sync(&grp_data->garbage_collector.work);
+        destroyMessageManager(grp_data->msg_manager);
 
-    if (err < 0) {
-        printk(KERN_INFO "Unable to register 'group%d' device file", grp_data->group_id);
-        ret = CHDEV_ALLOC_ERR;
-        goto cleanup_region;
+        list_for_each_safe(cursor, temp, &grp_data->active_members){
+            list_del(cursor);
+            kfree(list_entry(cursor, group_members_t, list));
+        }
     }
 
-    pr_debug("Device Major/Minor correctly allocated");
+    //Mappings of the page and eventfd registrations belong to files, so none is left
+    #ifndef DISABLE_THREAD_BARRIER
+        if(grp_data->barrier.shared)
+            free_pages((unsigned long)grp_data->barrier.shared, BARRIER_PAGES_ORDER);
+    #endif
 
+    releaseGroupStats(grp_data);
 
+    call_rcu(&grp_data->rcu, freeGroupRcu);
+}
 
-    grp_data->dev = device_create(group_device_class, parent, grp_data->deviceID, NULL, device_name);
+/**
+ * @brief Drop a reference on a group
+ * 
+ * @param[in] grp_data The group to release
+ * 
+ * @note When the last reference is dropped the structure is freed after an
+ *      RCU grace period
+ */
+void putGroup(group_data *grp_data){
+    kref_put(&grp_data->refcount, releaseGroupData);
+}
 
-    if(IS_ERR(grp_data->dev)){
-        printk(KERN_ERR "Unable to register the device");
-        ret = DEV_CREATION_ERR;
-        goto cleanup_device;
-    }
+
+/**
+ *  @brief register a group device 
+ *  @param [in] grp_data    The group data descriptor
+ *  @param [in] parent      device parent (usually 'main_device')
+ *  @param [in] config      Initial configuration of the message manager
+ * 
+ *  @note The device number is taken from the shared group region, so the
+ *      cost of this function does not depend on the number of installed groups
+ * 
+ *  @retval 0 on success
+ *  @retval ALLOC_ERR If some memory allocation fails
+ *  @retval DEV_CREATION_ERR If the char device creation fails
+ */
+int registerGroupDevice(group_data *grp_data, struct device* parent, const group_config_t *config){
+
+    char device_name[DEVICE_NAME_SIZE];    //Device name buffer
 
 
+    snprintf(device_name, DEVICE_NAME_SIZE, "synch!group%d", grp_data->group_id);
+    logGroup("Device name: %s", device_name);
+
+    //The minor number of a group device is its ID
+    grp_data->deviceID = MKDEV(MAJOR(group_region), MINOR(group_region) + grp_data->group_id);
+
 
     //Initialize linked-list
     initParticipants(grp_data);   
 
+    //Released with the group structure, as the counters are updated until then
+    if(initGroupStats(grp_data) < 0)
+        return ALLOC_ERR;
+
     //Initialize Message Manager  
-    grp_data->msg_manager = createMessageManager(DEFAULT_STORAGE_SIZE, DEFAULT_MSG_SIZE, &grp_data->garbage_collector);
+    grp_data->msg_manager = createMessageManager(config, &grp_data->garbage_collector);
     
-    if(!grp_data->msg_manager){
-        ret = ALLOC_ERR;
-        goto cleanup;
-    }
+    if(!grp_data->msg_manager)
+        return ALLOC_ERR;
+
+    grp_data->msg_manager->group = grp_data;
 
 
     #ifndef DISABLE_THREAD_BARRIER
         //Initialize Wait Queue
-        init_waitqueue_head(&grp_data->barrier_queue);
+        init_waitqueue_head(&grp_data->barrier.queue);
+
+        //Whole pages, so that they can be mapped in user space with different protections
+        grp_data->barrier.shared = (barrier_shared_t*)__get_free_pages(GFP_KERNEL | __GFP_ZERO, BARRIER_PAGES_ORDER);
+
+        if(!grp_data->barrier.shared){
+            destroyMessageManager(grp_data->msg_manager);
+            grp_data->msg_manager = NULL;
+            return ALLOC_ERR;
+        }
+
+        grp_data->barrier.counters = (barrier_counters_t*)((char*)grp_data->barrier.shared + PAGE_SIZE);
+        atomic_set(&grp_data->barrier.counters->parties, config->barrier_parties);
+
+        INIT_LIST_HEAD(&grp_data->barrier.eventfds);
+        spin_lock_init(&grp_data->barrier.eventfd_lock);
         grp_data->flags.thread_barrier_loaded = 1;
-        grp_data->flags.wake_up_flag = 0;
     #endif
 
 
 
-    /** @note Charter device creation
+    /** @note Device creation
     *   This should be perfomed after all the all the necessary data structures
-    *   are allocated since, immediately after 'cdev_add', the device becomes live
-    *   and starts to respond to requests
+    *   are allocated since the shared char device is already live: once the
+    *   device file appears, 'openGroup' resolves it through the IDR
     */
-    cdev_init(&grp_data->cdev, &group_operation);
+    grp_data->dev = device_create(group_device_class, parent, grp_data->deviceID, NULL, device_name);
 
-    err = cdev_add(&grp_data->cdev, grp_data->deviceID, 1);
-    if(err < 0){
-        pr_err("Unable to add char dev. Error %d", err);
-        ret = CDEV_ALLOC_ERR;
-        goto cleanup;
-    }
+    if(IS_ERR(grp_data->dev)){
+        printk(KERN_ERR "Unable to register the device");
+        destroyMessageManager(grp_data->msg_manager);
+        grp_data->msg_manager = NULL;
 
+        #ifndef DISABLE_THREAD_BARRIER
+            free_pages((unsigned long)grp_data->barrier.shared, BARRIER_PAGES_ORDER);
+            grp_data->barrier.shared = NULL;
+        #endif
 
-    pr_info("Device correctly added");
+        return DEV_CREATION_ERR;
+    }
 
-    return 0;
 
-    //----------------------------------------------------------
+    logGroup("Device correctly added");
 
-    cleanup:
-        device_destroy(group_device_class, grp_data->deviceID);
-    cleanup_device:
-        //class_destroy(group_device_class);
-    cleanup_region:
-        unregister_chrdev_region(grp_data->deviceID, 1);
-        return ret;
+    return 0;
 }
 
 /**
  *  @brief unregister a group device
+ * 
+ *  The device file is removed and the group is marked as not initialized, so
+ *  that files still open on it will fail. The group structure is not freed.
+ * 
  *  @param [in] grp_data    The group data descriptor
  *  @return nothing
  */
 
-void unregisterGroupDevice(group_data *grp_data, bool flag){
+void unregisterGroupDevice(group_data *grp_data){
 
-    pr_debug("Cleaning up 'group%d'", grp_data->group_id);
-    
-    if(!flag){
-        device_destroy(group_device_class, grp_data->deviceID);
-        return;
-    }
+    logGroup("Cleaning up 'group%d'", grp_data->group_id);
 
-    /** @note This guarantees that cdev device will no longer be able to be
-     * opened, however any cdevs already open will remain and their fops will
-     * still be callable even after cdev_del returns. For this reason the 
-     * 'initialized' flag of a group will be set to zero
+    /** @note Once the group is removed from the IDR its device can no longer
+     * be opened, however files already open will remain and their fops will
+     * still be callable. For this reason the 'initialized' flag of a group
+     * will be set to zero
      */
-    cdev_del(&grp_data->cdev);
     grp_data->flags.initialized = 0;
 
-    unregister_chrdev_region(grp_data->deviceID, 1);
-
-    #ifndef DISABLE_THREAD_BARRIER
-        //Waking up all the sleeped thread
-       pr_info("Waking up all the sleeped thread 'group%d'", grp_data->group_id);
-        grp_data->flags.wake_up_flag = 1;
-
-        /** @todo: Check if this causes starvation*/
-        //while(!resetSleepFlag(grp_data));
-    #endif
-
-
-    kfree(grp_data->msg_manager);
-
-    grp_data->flags.initialized = 0;
+    device_destroy(group_device_class, grp_data->deviceID);
 }
 
 
@@ -398,23 +550,42 @@ void unregisterGroupDevice(group_data *grp_data, bool flag){
 /**
  * @brief Called when an application opens the device file
  * 
- * Add the process that opened the device to the 'active_members' list
+ * Resolve the group from the device minor and add the process that opened
+ * the device to the 'active_members' list. The open file holds a reference
+ * on the group, that is dropped by 'releaseGroup'
  * 
  * @retval 0 on success
+ * @retval -ENODEV if no group is installed for the device minor
  * @retval -1 on error
  */
 static int openGroup(struct inode *inode, struct file *file){
     group_data *grp_data;
+    group_file_t *gfile;
+
+    grp_data = findGroup(iminor(inode) - MINOR(group_region));
 
-    grp_data = container_of(inode->i_cdev, group_data, cdev);
+    if(!grp_data)
+        return -ENODEV;
 
-    file->private_data = grp_data;
+    gfile = (group_file_t*)kmalloc(sizeof(group_file_t), GFP_KERNEL);
+    if(!gfile){
+        putGroup(grp_data);
+        return -ENOMEM;
+    }
+
+    gfile->group = grp_data;
+    gfile->member = current->pid;
+    gfile->shared = false;
 
-    pr_debug("Group %d opened", grp_data->group_id);
+    file->private_data = gfile;
+
+    logGroup("Group %d opened", grp_data->group_id);
 
 
     if(grp_data->flags.initialized == 0){
         printk(KERN_ERR "Device still not initialized or deallocated, close and reopen the file descriptor");
+        kfree(gfile);
+        putGroup(grp_data);
         return -1;
     }
 
@@ -422,19 +593,23 @@ static int openGroup(struct inode *inode, struct file *file){
     /** @todo: integrate in a function*/
     {
         group_members_t *newMember = (group_members_t*)kmalloc(sizeof(group_members_t), GFP_KERNEL);
+        u64 held;
+
         if(!newMember){
             printk(KERN_ERR "Unable to allocate new member");
+            kfree(gfile);
+            putGroup(grp_data);
             return -1;
         }
 
         newMember->pid = current->pid;
         
-        down_write(&grp_data->member_lock);
+        held = statsDownWrite(grp_data, LOCK_MEMBER, &grp_data->member_lock);
             list_add(&newMember->list, &grp_data->active_members);
-        up_write(&grp_data->member_lock);
+        statsUpWrite(grp_data, LOCK_MEMBER, &grp_data->member_lock, held);
 
-        atomic_inc(&grp_data->members_count);
-        printk("New member (%d) of group %d added", current->pid, grp_data->group_id);
+        statsAtomicPeak(&grp_data->stats.peak_members, atomic_inc_return(&grp_data->members_count));
+        logGroup("New member (%d) of group %d added", current->pid, grp_data->group_id);
     }
     
     return 0;
@@ -443,41 +618,51 @@ static int openGroup(struct inode *inode, struct file *file){
 /**
  * @brief Called when an application closes the device file
  * 
- * Remove the process that closed the device from the 'active_members' list
+ * Remove the member added by 'openGroup' from the 'active_members' list
  *  and start the garbage collector
  * 
  * @retval 0 on success
  * @retval -1 on error
  */
 static int releaseGroup(struct inode *inode, struct file *file){
+    group_file_t *gfile;
     group_data *grp_data;
     int ret;
+    u64 held;
 
-    grp_data =  (group_data*)file->private_data;
+    gfile = file->private_data;
+    grp_data = gfile->group;
 
-    pr_debug(" - Group %d released by %d - ", grp_data->group_id, current->pid);
+    logGroup(" - Group %d released by %d - ", grp_data->group_id, current->pid);
+
+    #ifndef DISABLE_THREAD_BARRIER
+        unregisterBarrierEventfd(grp_data, file, NULL);
+    #endif
 
     if(grp_data->flags.initialized == 0){
         printk(KERN_WARNING "Device still not initialized or deallocated, close and reopen the file descriptor");
-        return -1;
+        ret = -1;
+        goto put_group;
     }
 
-    down_write(&grp_data->member_lock);
-        ret = removeParticipant(&grp_data->active_members, current->pid);
-    up_write(&grp_data->member_lock);
+    held = statsDownWrite(grp_data, LOCK_MEMBER, &grp_data->member_lock);
+        ret = removeParticipant(&grp_data->active_members, gfile->member);
+    statsUpWrite(grp_data, LOCK_MEMBER, &grp_data->member_lock, held);
 
     if(ret == EMPTY_LIST){
         printk(KERN_WARNING "Releasig group, active members list already empty!");
-        return 0;
+        ret = 0;
+        goto put_group;
     }
     if(ret == NODE_NOT_FOUND){
-        pr_debug("Releasig group, PID not found inside active members list");
-        return 0;
+        logGroup("Releasig group, PID not found inside active members list");
+        ret = 0;
+        goto put_group;
     }
 
     atomic_dec(&grp_data->members_count);
 
-    pr_debug("Removed participant %d from active members", current->pid);
+    logGroup("Removed participant %d from active members", gfile->member);
 
 
     if(isGarbageCollEnabled(grp_data) && checkGarbageRatio(grp_data)){
@@ -485,119 +670,96 @@ static int releaseGroup(struct inode *inode, struct file *file){
         schedule_work(&grp_data->garbage_collector.work);
     }
 
-    return 0;
+    put_group:
+        //Drop the reference taken by 'openGroup'
+        kfree(gfile);
+        putGroup(grp_data);
+        return ret;
 }
 
 /**
- * @brief Consult the message-manager and fetch incoming structure 
+ * @brief Deliver a message of a group to a user-space buffer
  * 
- * @param [in]		file	file structure
- * @param [out]		user_buffer		buffer address (user)
- * @param [in]		_size	read data size
- * @param [in,out]	offset	file position (Currently Unused)
+ * @param [in]		grp_data	the group
+ * @param [in]		reader		member key of the reader, see 'fileMember'
+ * @param [out]		user_buffer	buffer address (user)
+ * @param [in]		_size		size of the user buffer
+ * @param [out]		author		author of the delivered message, may be NULL
  * 
- * @note 'offset' is ignored since messages are independent data unit
- * @note If more byte than the available is requested, the function only copies the 
- *          available bytes.
- * @return The number of bytes readed
+ * @note A message longer than the buffer is never truncated: it is left in 
+ *          the queue, so the reader can retry with a larger buffer
+ * 
+ * @retval The number of bytes copied
+ * @retval NO_MSG_PRESENT if no message is available for the reader
+ * @retval -EMSGSIZE if the next message is longer than '_size'
+ * @retval MEMORY_ERROR if the copy to user-space fails
+ * @retval -1 on error
  */
-static ssize_t readGroupMessage(struct file *file, char __user *user_buffer, size_t _size, loff_t *offset){
-    group_data *grp_data;
+static ssize_t sReadOne(group_data *grp_data, const pid_t reader, char __user *user_buffer, const size_t _size, pid_t *author){
     msg_t message;
-    ssize_t available_size;
     int ret;
 
-    grp_data = (group_data*) file->private_data;
-
-    pr_debug("Reading messages from group%d", grp_data->group_id);
-
-    if(grp_data->flags.initialized == 0){
-        pr_err("Device still not initialized or deallocated, close and reopen the file descriptor");
+    if(!user_buffer){
+        pr_err("\nInvaid user buffer provided, exiting...");
         return -1;
     }
 
-
-    ret = readMessage(&message, grp_data->msg_manager);
+    ret = readMessage(&message, grp_data->msg_manager, reader, _size);
     if(ret == 1){
-        pr_debug("No message available");
+        logMessage("No message available");
         return NO_MSG_PRESENT;
+    }else if(ret == -EMSGSIZE){
+        return ret;
     }else if(ret == -1){    //Critical Error
         printk(KERN_WARNING "Critical error while processing the message");
         return -1;   
     }
 
 
-    pr_debug("A message was available!!");
-    pr_debug("Message content: %s", (char*)message.buffer);
-    
-    if(!user_buffer){
-        pr_err("\nInvaid user buffer provided, exiting...");
-        return -1;
-    }
-
-
-    //If the user-space application request more byte than available, return only available bytes
-    if(message.size < _size){
-        available_size = message.size;
-    }else{
-        available_size = _size;
-    }
+    logMessage("A message was available!!");
+    logMessage("Message content: %s", (char*)message.buffer);
 
 
     //Parse the message
-    if(copy_msg_to_user(&message, user_buffer, available_size) == -EFAULT){
+    if(copy_msg_to_user(&message, user_buffer, message.size) == -EFAULT){
         pr_err("Unable to copy the message to user-space");
         return MEMORY_ERROR;
     }
 
-    pr_debug("Message copied to user-space");
-    
-    if(isGarbageCollEnabled(grp_data) && checkGarbageRatio(grp_data)){
-        //Start a workqueue for cleaning up message that are completely delivered
-        schedule_work(&grp_data->garbage_collector.work);
-    }
+    logMessage("Message copied to user-space");
 
+    if(author)
+        *author = message.author;
 
-    return available_size;
+    return message.size;
 }
 
 /**
- * @brief Routine called when a 'write()' is issued on the group char device
+ * @brief Write a user-space message into a group, directly or through the delayed queue
  * 
- * @param [in]		filep	file structure
- * @param [in]		buf		buffer address (user)
- * @param [in]		_size	write data size
- * @param [in,out]	f_pos	file position (Currently Unused)
+ * @param [in]		grp_data	the group
+ * @param [in]		sender		member key of the writer, see 'fileMember'
+ * @param [in]		buf			buffer address (user)
+ * @param [in]		_size		write data size
+ * 
+ * @note The author reported to readers is the calling thread, also when 
+ *          'sender' is the key of a shared handle
+ * @note If no storage is left the garbage collector is started and the write 
+ *          is retried once
  * 
  * @retval 0 on success
- * @retval MSG_SIZE_ERROR if the size of message is wrong, 
+ * @retval -1 on error
  */
-
-static ssize_t writeGroupMessage(struct file *filep, const char __user *buf, size_t _size, loff_t *f_pos){
-    group_data *grp_data;
-    msg_t* msgTemp;
+static int sWriteOne(group_data *grp_data, const pid_t sender, const char __user *buf, const size_t _size){
+    msg_t message;
     int ret;
     bool garbageCollectorRetry = false;
 
-    grp_data = (group_data*) filep->private_data;
-
-
-    if(grp_data->flags.initialized == 0){
-        pr_err("Device still not initialized or deallocated, close and reopen the file descriptor");
+    if(copy_msg_from_user(&message, (int8_t*)buf, _size) < 0)
         return -1;
-    }
-
-
-    msgTemp = (msg_t*)kmalloc(sizeof(msg_t), GFP_KERNEL);
 
-    if(!msgTemp)
-        return 0;
-
-    if(copy_msg_from_user(msgTemp, (int8_t*)buf, _size) < 0)
-        goto cleanup;
-
-    msgTemp->author = current->pid;
-    msgTemp->size = _size;
+    message.author = current->pid;
+    message.size = _size;
 
     //If no space is left, call the garbage collector and retry
     garbage_collector_retry:      
@@ -605,17 +767,17 @@ static ssize_t writeGroupMessage(struct file *filep, const char __user *buf, siz
     #ifndef DISABLE_DELAYED_MSG
 
         if(isDelaySet(grp_data->msg_manager)){
-            ret = queueDelayedMessage(msgTemp, grp_data->msg_manager);
+            ret = queueDelayedMessage(&message, grp_data->msg_manager, sender);
         }else
-            ret = writeMessage(msgTemp, grp_data->msg_manager);
+            ret = writeMessage(&message, grp_data->msg_manager, sender);
         
     #else
-        ret = writeMessage(msgTemp, grp_data->msg_manager);
+        ret = writeMessage(&message, grp_data->msg_manager, sender);
     #endif
 
 
     if(ret == STORAGE_SIZE_ERR && !garbageCollectorRetry){
-        pr_debug("Starting garbage collector and retry...");
+        logMessage("Starting garbage collector and retry...");
         
         schedule_work(&grp_data->garbage_collector.work);
 
@@ -627,128 +789,831 @@ static ssize_t writeGroupMessage(struct file *filep, const char __user *buf, siz
 
 
     if(ret < 0){
-        pr_debug("Unable to write the message: %d", ret);
+        logMessage("Unable to write the message: %d", ret);
+        kfree(message.buffer);
         return -1;
     }
 
-    pr_debug("Message for group%d queued", grp_data->group_id);
+    logMessage("Message for group%d queued", grp_data->group_id);
 
     return ret;
-
-
-    cleanup:
-        kfree(msgTemp);
-        return -1;
 }
 
-
 /**
- * @brief Remove all messages from the delay queue and make it immediately available
+ * @brief Consult the message-manager and fetch incoming structure 
  * 
- * @retval The number of removed messages
- * @retval Negative number on error
+ * @param [in]		file	file structure
+ * @param [out]		user_buffer		buffer address (user)
+ * @param [in]		_size	read data size
+ * @param [in,out]	offset	file position (Currently Unused)
+ * 
+ * @note 'offset' is ignored since messages are independent data unit
+ * @note If more byte than the available is requested, the function only copies the 
+ *          available bytes. If less are requested the read fails with 
+ *          'EMSGSIZE' and the message stays in the queue.
+ * @return The number of bytes readed
  */
-static int flushGroupMessage(struct file *filep, fl_owner_t id){
+static ssize_t readGroupMessage(struct file *file, char __user *user_buffer, size_t _size, loff_t *offset){
     group_data *grp_data;
-    msg_manager_t *manager;
-    int ret = 0;
+    ssize_t ret;
 
-    grp_data = (group_data*) filep->private_data;
+    grp_data = fileGroup(file);
 
+    logMessage("Reading messages from group%d", grp_data->group_id);
 
     if(grp_data->flags.initialized == 0){
         pr_err("Device still not initialized or deallocated, close and reopen the file descriptor");
         return -1;
     }
 
-    #ifdef LEGACY_FLUSH
-    rcu_read_lock();
-    manager = rcu_dereference(grp_data->msg_manager);
-
-    if(atomic_long_read(&manager->message_delay) == 0)
-        return 0;
-
-    ret = cancelDelay(manager);
-    pr_debug("flush: %d elements flushed from the delayed queue", ret);
 
-    rcu_read_unlock();
+    ret = sReadOne(grp_data, fileMember(file), user_buffer, _size, NULL);
+    if(ret <= 0)
+        return ret;
+    
+    if(isGarbageCollEnabled(grp_data) && checkGarbageRatio(grp_data)){
+        //Start a workqueue for cleaning up message that are completely delivered
+        schedule_work(&grp_data->garbage_collector.work);
+    }
 
-    #endif
 
-    pr_info("flush: %d elements flushed from the delayed queue", ret);
     return ret;
 }
 
-
-#ifndef DISABLE_THREAD_BARRIER
 /**
- * @brief Resets the flag used to wake up threds
- * @param[in] grp_data Pointer to the main structure group
+ * @brief Routine called when a 'write()' is issued on the group char device
+ * 
+ * @param [in]		filep	file structure
+ * @param [in]		buf		buffer address (user)
+ * @param [in]		_size	write data size
+ * @param [in,out]	f_pos	file position (Currently Unused)
  * 
- * @retval true if the flag was resetted
- * @retval false otherwise
+ * @retval 0 on success
+ * @retval MSG_SIZE_ERROR if the size of message is wrong, 
  */
-bool resetSleepFlag(group_data *grp_data){
-    bool ret_flag = false;
 
-    spin_lock(&grp_data->barrier_queue.lock);
-        if(!waitqueue_active(&grp_data->barrier_queue)){
-            pr_debug("resetSleepFlag: wake_up_flag resetted");
-            grp_data->flags.wake_up_flag = 0;
-            ret_flag = true;
-        }
-    spin_unlock(&grp_data->barrier_queue.lock);
+static ssize_t writeGroupMessage(struct file *filep, const char __user *buf, size_t _size, loff_t *f_pos){
+    group_data *grp_data;
 
-    return ret_flag;
-}
+    grp_data = fileGroup(filep);
+
+
+    if(grp_data->flags.initialized == 0){
+        pr_err("Device still not initialized or deallocated, close and reopen the file descriptor");
+        return -1;
+    }
 
+    return sWriteOne(grp_data, fileMember(filep), buf, _size);
+}
 
 /**
- * @brief Put the thread which calles this function on sleep
+ * @brief Read several messages with a single syscall ('IOCTL_READ_MESSAGES')
  * 
- * @param[in] grp_data Pointer to the main structure of a group
+ * For each element of the user array, 'buffer' and 'size' describe the 
+ * destination buffer: on return 'size' holds the copied bytes and 'author'
+ * the author of the message. Reading stops at the first element for which
+ * no message is available, or whose buffer is shorter than the next message.
  * 
- * @return nothing
+ * @retval The number of messages read
+ * @retval -EFAULT if the user array is not accessible
+ * @retval -EINTR if the caller was killed before the first read
+ * @retval -EINVAL if the first element has an empty buffer
+ * @retval -EMSGSIZE if the first buffer is shorter than the next message
+ * @retval Negative number if the first read fails
+ * 
+ * @note A message that was taken from the queue but could not be copied or
+ *          described to user space is reported through the error (MEMORY_ERROR
+ *          or -EFAULT) also after other reads, instead of the count
  */
-void sleepOnBarrier(group_data *grp_data){
-    
-    if(resetSleepFlag(grp_data)){
-        pr_debug("First thread inserted into the queue");
-    }else{
-        pr_debug("Sleep flag already set to 'false'");
+static long sReadMessages(struct file *filep, msg_batch_t __user *user_batch){
+    group_data *grp_data = fileGroup(filep);
+    pid_t reader = fileMember(filep);
+    msg_batch_t batch;
+    msg_t umsg;
+    ssize_t ret = 0;
+    bool lost = false;
+    size_t i;
+
+    if(copy_from_user(&batch, user_batch, sizeof(msg_batch_t)))
+        return -EFAULT;
+
+    for(i = 0; i < batch.count; i++){
+        //'count' comes from user space: the batch must stay killable
+        if(fatal_signal_pending(current)){
+            ret = -EINTR;
+            break;
+        }
+
+        if(copy_from_user(&umsg, &batch.messages[i], sizeof(msg_t))){
+            ret = -EFAULT;
+            break;
+        }
+
+        //An empty buffer could only receive an empty message, read as "no message"
+        if(umsg.size == 0){
+            ret = -EINVAL;
+            break;
+        }
+
+        ret = sReadOne(grp_data, reader, (char __user*)umsg.buffer, umsg.size, &umsg.author);
+        if(ret == MEMORY_ERROR)
+            lost = true;
+        if(ret <= 0)
+            break;
+
+        if(put_user((size_t)ret, &batch.messages[i].size) || put_user(umsg.author, &batch.messages[i].author)){
+            ret = -EFAULT;
+            lost = true;
+            break;
+        }
+
+        cond_resched();
+    }
+
+    //A single check of the garbage collector for the whole batch
+    if((i > 0 || lost) && isGarbageCollEnabled(grp_data) && checkGarbageRatio(grp_data))
+        schedule_work(&grp_data->garbage_collector.work);
+
+    //The message was delivered: the count alone would hide that it was lost
+    if(lost)
+        return (long)ret;
+
+    return i > 0 ? (long)i : (long)ret;
+}
+
+/**
+ * @brief Write several messages with a single syscall ('IOCTL_WRITE_MESSAGES')
+ * 
+ * Each element of the user array describes a message through 'buffer' and 
+ * 'size', 'author' is ignored. Writing stops at the first failure.
+ * 
+ * @retval The number of messages written
+ * @retval -EFAULT if the user array is not accessible
+ * @retval -EINTR if the caller was killed before the first write
+ * @retval -1 if the first write fails
+ */
+static long sWriteMessages(struct file *filep, msg_batch_t __user *user_batch){
+    group_data *grp_data = fileGroup(filep);
+    pid_t author = fileMember(filep);
+    msg_batch_t batch;
+    msg_t umsg;
+    int ret = 0;
+    size_t i;
+
+    if(copy_from_user(&batch, user_batch, sizeof(msg_batch_t)))
+        return -EFAULT;
+
+    for(i = 0; i < batch.count; i++){
+        if(fatal_signal_pending(current)){
+            ret = -EINTR;
+            break;
+        }
+
+        if(copy_from_user(&umsg, &batch.messages[i], sizeof(msg_t))){
+            ret = -EFAULT;
+            break;
+        }
+
+        ret = sWriteOne(grp_data, author, (const char __user*)umsg.buffer, umsg.size);
+        if(ret < 0)
+            break;
+
+        cond_resched();
+    }
+
+    return i > 0 ? (long)i : (long)ret;
+}
+
+/**
+ * @brief Size of the next message available to the member of the file ('IOCTL_NEXT_MESSAGE_SIZE')
+ * 
+ * The message is not delivered: the next read returns it, unless other 
+ * threads read through the same member (see 'fileMember') in the meantime.
+ * 
+ * @retval 0 if a message is available, its size is written to 'user_size'
+ * @retval 1 if no message is available
+ * @retval -EFAULT if 'user_size' is not accessible
+ */
+static long sNextMessageSize(struct file *filep, size_t __user *user_size){
+    size_t size;
+
+    if(peekMessage(fileGroup(filep)->msg_manager, fileMember(filep), &size) != 0)
+        return 1;
+
+    if(put_user(size, user_size))
+        return -EFAULT;
+
+    return 0;
+}
+
+/**
+ * @brief Routine called when a group device is polled (poll, select, epoll)
+ * 
+ * The device is readable when a message is available for the member of the 
+ * caller (see 'fileMember') and is always writable, since writes never block.
+ * Pollers are woken up by 'writeMessage' every time a message is added to
+ * the FIFO queue, including delayed messages whose delay elapsed.
+ * 
+ * @retval The mask of ready events
+ * @retval EPOLLERR | EPOLLHUP if the group was uninstalled
+ */
+static __poll_t pollGroup(struct file *filep, poll_table *wait){
+    group_data *grp_data;
+    __poll_t mask;
+
+    grp_data = fileGroup(filep);
+
+    poll_wait(filep, &grp_data->msg_manager->read_wait, wait);
+
+    if(grp_data->flags.initialized == 0)
+        return EPOLLERR | EPOLLHUP;
+
+    mask = EPOLLOUT | EPOLLWRNORM;
+
+    if(hasMessage(grp_data->msg_manager, fileMember(filep)))
+        mask |= EPOLLIN | EPOLLRDNORM;
+
+    return mask;
+}
+
+
+/**
+ * @brief Remove all messages from the delay queue and make it immediately available
+ * 
+ * @retval The number of removed messages
+ * @retval Negative number on error
+ */
+static int flushGroupMessage(struct file *filep, fl_owner_t id){
+    group_data *grp_data;
+    msg_manager_t *manager;
+    int ret = 0;
+
+    grp_data = fileGroup(filep);
+
+
+    if(grp_data->flags.initialized == 0){
+        pr_err("Device still not initialized or deallocated, close and reopen the file descriptor");
+        return -1;
+    }
+
+    #ifdef LEGACY_FLUSH
+    rcu_read_lock();
+    manager = rcu_dereference(grp_data->msg_manager);
+
+    if(atomic_long_read(&manager->message_delay) == 0)
+        return 0;
+
+    ret = cancelDelay(manager);
+    logDelay("flush: %d elements flushed from the delayed queue", ret);
+
+    rcu_read_unlock();
+
+    #endif
+
+    logDelay("flush: %d elements flushed from the delayed queue", ret);
+    return ret;
+}
+
+
+#ifndef DISABLE_THREAD_BARRIER
+/**
+ * @brief Sleeping condition of a thread that recorded 'generation'
+ */
+#define barrierReleased(grp_data, generation) \
+    (barrierGeneration(&(grp_data)->barrier) != (generation) || !(grp_data)->flags.initialized)
+
+/**
+ * @brief Read the current generation of a barrier
+ */
+static inline u32 barrierGeneration(thread_barrier_t *barrier){
+    return BARRIER_GENERATION(atomic64_read(&barrier->shared->state));
+}
+
+/**
+ * @brief Advance the generation of a barrier, resetting the arrival count
+ * 
+ * @param[in] barrier The barrier to release
+ * @param[in] state   The last known state word, the update fails if it changed
+ * 
+ * @retval true if the generation was advanced
+ * @retval false if 'state' is stale
+ */
+static inline bool sReleaseGeneration(thread_barrier_t *barrier, s64 state){
+    s64 next = BARRIER_STATE(BARRIER_GENERATION(state) + 1, 0);
+
+    return atomic64_cmpxchg(&barrier->shared->state, state, next) == state;
+}
+
+/**
+ * @brief Wake function of the threads sleeping on the barrier
+ * 
+ * Called with the wait queue lock held: the waiter is marked as released and
+ * removed from the queue, so that it is counted by 'wake_up_nr' exactly once
+ * even if it was already running (e.g. because of a signal).
+ * If 'key' points to a generation, waiters that are sleeping on it are skipped.
+ */
+static int barrierWakeFunction(struct wait_queue_entry *entry, unsigned int mode, int sync, void *key){
+    barrier_waiter_t *waiter = container_of(entry, barrier_waiter_t, entry);
+
+    if(key && *(u32*)key == waiter->generation)
+        return 0;
+
+    waiter->released = true;
+    default_wake_function(entry, mode, sync, key);
+    list_del_init(&entry->entry);
+
+    return 1;
+}
+
+/**
+ * @brief Sleep on the barrier as an exclusive waiter, while its generation is 'generation'
+ * 
+ * Waiters are queued in FIFO order, so 'wake_up_nr' releases the oldest ones. 
+ * A waiter is also released when the generation changes or the group is 
+ * uninstalled. The number of sleepers is published in the counters page, so 
+ * that user space can skip the wake-up syscall when nobody is sleeping.
+ * 
+ * @param[in] grp_data   Pointer to the main structure of a group
+ * @param[in] generation The generation observed by the caller
+ * @param[in] timeout    Maximum sleeping time in jiffies, MAX_SCHEDULE_TIMEOUT for no timeout
+ * 
+ * @retval 0 when the thread is woken up or the generation already changed
+ * @retval BARRIER_TIMED_OUT if the timeout expired before an awake
+ * @retval -EINTR if the sleep was interrupted by a signal
+ */
+static int sWaitOnBarrier(group_data *grp_data, const u32 generation, long timeout){
+    thread_barrier_t *barrier = &grp_data->barrier;
+    barrier_waiter_t waiter;
+    int ret = 0;
+
+    init_wait(&waiter.entry);
+    waiter.entry.func = barrierWakeFunction;
+    waiter.generation = generation;
+    waiter.released = false;
+
+    //Pairs with the generation update of the waker
+    atomic_inc(&barrier->counters->sleepers);
+    smp_mb__after_atomic();
+
+    logBarrier("Putting thread %d to sleep on generation %u", current->pid, generation);
+    trace_synch_barrier_sleep(grp_data->group_id, current->pid, generation);
+
+    for(;;){
+        prepare_to_wait_exclusive(&barrier->queue, &waiter.entry, TASK_INTERRUPTIBLE);
+
+        if(READ_ONCE(waiter.released) || barrierReleased(grp_data, generation))
+            break;
+
+        if(signal_pending(current)){
+            ret = -EINTR;
+            break;
+        }
+
+        if(timeout == 0){
+            ret = BARRIER_TIMED_OUT;
+            break;
+        }
+
+        timeout = schedule_timeout(timeout);
+    }
+
+    finish_wait(&barrier->queue, &waiter.entry);
+    atomic_dec(&barrier->counters->sleepers);
+
+    //A wake-up that raced with the signal or the timeout must not be lost
+    if(ret != 0){
+        spin_lock_irq(&barrier->queue.lock);
+            if(waiter.released)
+                ret = 0;
+        spin_unlock_irq(&barrier->queue.lock);
+    }
+
+    logBarrier("Thread %d left the barrier: %d", current->pid, ret);
+    trace_synch_barrier_leave(grp_data->group_id, current->pid, generation, ret);
+
+    return ret;
+}
+
+/**
+ * @brief Put the thread which calles this function on sleep
+ * 
+ * The thread sleeps until it is woken up by an awake, until the group is 
+ * uninstalled or until a signal is received.
+ * 
+ * @param[in] grp_data Pointer to the main structure of a group
+ * 
+ * @retval 0 when the thread is woken up
+ * @retval -EINTR if the sleep was interrupted by a signal
+ */
+int sleepOnBarrier(group_data *grp_data){
+    return sWaitOnBarrier(grp_data, barrierGeneration(&grp_data->barrier), MAX_SCHEDULE_TIMEOUT);
+}
+
+/**
+ * @brief Put the thread which calles this function on sleep for at most 'timeout' ms
+ * 
+ * Same as 'sleepOnBarrier', but the thread gives up when the timeout expires.
+ * 
+ * @param[in] grp_data Pointer to the main structure of a group
+ * @param[in] timeout  Maximum sleeping time in milliseconds
+ * 
+ * @retval 0 when the thread is woken up
+ * @retval BARRIER_TIMED_OUT if the timeout expired before an awake
+ * @retval -EINTR if the sleep was interrupted by a signal
+ * @retval -EINVAL if the timeout is negative
+ */
+int sleepOnBarrierTimeout(group_data *grp_data, const long timeout){
+
+    if(timeout < 0)
+        return -EINVAL;
+
+    return sWaitOnBarrier(grp_data, barrierGeneration(&grp_data->barrier), msecs_to_jiffies(timeout));
+}
+
+/**
+ * @brief Sleep only if the barrier's generation is still 'generation'
+ * 
+ * Slow path of the user-space barrier: the generation is read from the 
+ * shared page, so a wake-up happening before the syscall is not lost.
+ * 
+ * @param[in] grp_data   Pointer to the main structure of a group
+ * @param[in] generation The generation observed by user space
+ * 
+ * @retval 0 when the thread is woken up or the generation already changed
+ * @retval -EINTR if the sleep was interrupted by a signal
+ */
+int waitBarrierGeneration(group_data *grp_data, const u32 generation){
+    return sWaitOnBarrier(grp_data, generation, MAX_SCHEDULE_TIMEOUT);
+}
+
+/**
+ * @brief Signal all the eventfds registered on the barrier
+ * 
+ * @note The decision relies on the list itself: the 'watchers' counter is only
+ *      a copy published to user space
+ */
+static void sSignalEventfds(thread_barrier_t *barrier){
+    barrier_eventfd_t *entry;
+
+    if(list_empty(&barrier->eventfds))
+        return;
+
+    spin_lock(&barrier->eventfd_lock);
+        list_for_each_entry(entry, &barrier->eventfds, list){
+            #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+                eventfd_signal(entry->ctx);
+            #else
+                eventfd_signal(entry->ctx, 1);
+            #endif
+        }
+    spin_unlock(&barrier->eventfd_lock);
+}
+
+/**
+ * @brief Register an eventfd to be signalled when the barrier is released
+ * 
+ * @param[in] grp_data  Pointer to the main structure of a group
+ * @param[in] filep     The group file the registration belongs to
+ * @param[in] fd        The eventfd file descriptor of the caller
+ * 
+ * @retval 0 on success
+ * @retval -EBADF/-EINVAL if 'fd' is not an eventfd
+ * @retval -EEXIST if the eventfd is already registered through 'filep'
+ * @retval ALLOC_ERR if the registration cannot be allocated
+ */
+int registerBarrierEventfd(group_data *grp_data, struct file *filep, const int fd){
+    thread_barrier_t *barrier = &grp_data->barrier;
+    barrier_eventfd_t *entry, *cursor;
+    struct eventfd_ctx *ctx;
+
+    ctx = eventfd_ctx_fdget(fd);
+
+    if(IS_ERR(ctx))
+        return PTR_ERR(ctx);
+
+    entry = (barrier_eventfd_t*)kmalloc(sizeof(barrier_eventfd_t), GFP_KERNEL);
+
+    if(!entry){
+        eventfd_ctx_put(ctx);
+        return ALLOC_ERR;
     }
 
-    pr_info("Putting thread %d to sleep...", current->pid);
-    wait_event(grp_data->barrier_queue, grp_data->flags.wake_up_flag == 1);
+    entry->ctx = ctx;
+    entry->owner = filep;
+
+    spin_lock(&barrier->eventfd_lock);
 
-    pr_info("Thread %d woken up!!", current->pid);
-    schedule();
+        list_for_each_entry(cursor, &barrier->eventfds, list){
+            if(cursor->ctx == ctx && cursor->owner == filep){
+                spin_unlock(&barrier->eventfd_lock);
+                eventfd_ctx_put(ctx);
+                kfree(entry);
+                return -EEXIST;
+            }
+        }
 
+        list_add_tail(&entry->list, &barrier->eventfds);
+        atomic_inc(&barrier->counters->watchers);
+
+    spin_unlock(&barrier->eventfd_lock);
+
+    logBarrier("Eventfd registered on the barrier of 'group%d'", grp_data->group_id);
+
+    return 0;
+}
+
+/**
+ * @brief Remove eventfd registrations made through a group file
+ * 
+ * @param[in] grp_data  Pointer to the main structure of a group
+ * @param[in] filep     The group file the registrations belong to
+ * @param[in] ctx       The eventfd to remove, NULL to remove all the registrations of 'filep'
+ * 
+ * @return The number of removed registrations
+ */
+int unregisterBarrierEventfd(group_data *grp_data, struct file *filep, struct eventfd_ctx *ctx){
+    thread_barrier_t *barrier = &grp_data->barrier;
+    barrier_eventfd_t *entry, *temp;
+    LIST_HEAD(removed);
+    int count = 0;
+
+    spin_lock(&barrier->eventfd_lock);
+        list_for_each_entry_safe(entry, temp, &barrier->eventfds, list){
+            if(entry->owner == filep && (!ctx || entry->ctx == ctx)){
+                list_move(&entry->list, &removed);
+                atomic_dec(&barrier->counters->watchers);
+                count++;
+            }
+        }
+    spin_unlock(&barrier->eventfd_lock);
+
+    //Contexts are released outside the spinlock
+    list_for_each_entry_safe(entry, temp, &removed, list){
+        eventfd_ctx_put(entry->ctx);
+        kfree(entry);
+    }
+
+    return count;
+}
+
+/**
+ * @brief Wake up the threads sleeping on an old generation
+ * 
+ * Called after the generation has been advanced, either by the kernel or
+ * directly in the shared page by user space (slow path of the user-space 
+ * barrier). Threads that already went to sleep on the current generation 
+ * keep sleeping. The wait queue lock is taken only if someone is sleeping.
+ * Registered eventfds are signalled as well.
+ * 
+ * @param[in] grp_data Pointer to the main structure of a group
+ * 
+ * @return nothing
+ */
+void wakeBarrierGeneration(group_data *grp_data){
+    thread_barrier_t *barrier = &grp_data->barrier;
+    u32 generation;
+
+    sSignalEventfds(barrier);
+
+    generation = barrierGeneration(barrier);
+    trace_synch_barrier_wake(grp_data->group_id, current->pid, generation, atomic_read(&barrier->counters->sleepers));
+
+    if(!wq_has_sleeper(&barrier->queue))
+        return;
+
+    __wake_up(&barrier->queue, TASK_NORMAL, 0, &generation);
 }
 
 /**
  * @brief Wake up all threads that was put on sleep by the module
+ * 
+ * The generation is advanced even if no thread is sleeping.
+ * 
  * @param[in] grp_data Pointer to the main structure of a group
  * 
  * @return nothing
  */
 void awakeBarrier(group_data *grp_data){
+    thread_barrier_t *barrier = &grp_data->barrier;
+    s64 state;
 
-    pr_debug("Waking up threads in the barrier_queue");
+    do{
+        state = atomic64_read(&barrier->shared->state);
+    }while(!sReleaseGeneration(barrier, state));
 
-    grp_data->flags.wake_up_flag = 1;
-    wake_up_all(&grp_data->barrier_queue);
+    logBarrier("Waking up threads in the barrier queue");
+    wakeBarrierGeneration(grp_data);
+}
 
-    //resetSleepFlag(grp_data);
+/**
+ * @brief Wake up at most 'count' threads sleeping on the barrier
+ * 
+ * Threads are woken up in the order they went to sleep. The generation is 
+ * not advanced, so the other sleepers keep waiting. Threads waiting in 
+ * 'arriveOnBarrier' can be woken up as well, their arrival is withdrawn.
+ * 
+ * @param[in] grp_data Pointer to the main structure of a group
+ * @param[in] count    Number of threads to wake up
+ * 
+ * @return nothing
+ */
+void awakeBarrierN(group_data *grp_data, const unsigned int count){
+    thread_barrier_t *barrier = &grp_data->barrier;
 
-    pr_info("Queue waked up");
+    if(count == 0 || !wq_has_sleeper(&barrier->queue))
+        return;
 
-    return;
+    logBarrier("Waking up %u threads in the barrier queue", count);
+    wake_up_nr(&barrier->queue, count);
 }
 
+/**
+ * @brief Arrive on the counted barrier and sleep until all parties arrived
+ * 
+ * The arrival count and the generation share the same word of the shared
+ * page, so arrivals performed directly by user space are counted as well.
+ * The last thread to arrive advances the generation and wakes up all the 
+ * others, without any external awake. An awake performed while threads are 
+ * waiting releases them as well and restarts the count.
+ * A thread woken up by 'awakeBarrierN' leaves while the barrier is still 
+ * pending: as for a signal, its arrival is withdrawn, so arriving again does 
+ * not count it twice.
+ * 
+ * @param[in] grp_data Pointer to the main structure of a group
+ * 
+ * @retval BARRIER_SERIAL_THREAD to the thread that released the barrier
+ * @retval 0 to the other threads, and to those woken up by 'awakeBarrierN'
+ * @retval BARRIER_NOT_SET if the number of parties is not set
+ * @retval -EINTR if the sleep was interrupted by a signal, the arrival is withdrawn
+ */
+int arriveOnBarrier(group_data *grp_data){
+    thread_barrier_t *barrier = &grp_data->barrier;
+    unsigned int parties;
+    s64 state, next;
+    int ret;
+
+    parties = atomic_read(&barrier->counters->parties);
+
+    if(parties == 0)
+        return BARRIER_NOT_SET;
+
+    for(;;){
+        state = atomic64_read(&barrier->shared->state);
+
+        if(BARRIER_ARRIVED(state) + 1 >= parties){
+            if(!sReleaseGeneration(barrier, state))
+                continue;
+
+            logBarrier("Thread %d released generation %u", current->pid, BARRIER_GENERATION(state));
+            wakeBarrierGeneration(grp_data);
+            return BARRIER_SERIAL_THREAD;
+        }
+
+        next = BARRIER_STATE(BARRIER_GENERATION(state), BARRIER_ARRIVED(state) + 1);
+
+        if(atomic64_cmpxchg(&barrier->shared->state, state, next) == state)
+            break;
+    }
+
+
+    ret = sWaitOnBarrier(grp_data, BARRIER_GENERATION(state), MAX_SCHEDULE_TIMEOUT);
+
+    //Interrupted, or woken up by 'awakeBarrierN' without a release
+    if(ret != 0 || !barrierReleased(grp_data, BARRIER_GENERATION(next))){
+        //Withdraw the arrival, unless the barrier was released in the meantime
+        do{
+            state = atomic64_read(&barrier->shared->state);
+
+            if(BARRIER_GENERATION(state) != BARRIER_GENERATION(next) || BARRIER_ARRIVED(state) == 0)
+                return 0;
+
+            next = state - 1;
+        }while(atomic64_cmpxchg(&barrier->shared->state, state, next) != state);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Set the number of threads that release the counted barrier
+ * 
+ * If enough threads already arrived for the new value, they are released.
+ * 
+ * @param[in] grp_data  Pointer to the main structure of a group
+ * @param[in] parties   The new number of parties, 0 disables the counted barrier
+ * 
+ * @retval 0 on success
+ */
+int setBarrierParties(group_data *grp_data, const unsigned int parties){
+    thread_barrier_t *barrier = &grp_data->barrier;
+    s64 state;
+
+    atomic_set(&barrier->counters->parties, parties);
+    smp_mb__after_atomic();
+
+    do{
+        state = atomic64_read(&barrier->shared->state);
+
+        if(BARRIER_ARRIVED(state) == 0 || BARRIER_ARRIVED(state) < parties)
+            return 0;
+
+    }while(!sReleaseGeneration(barrier, state));
+
+    wakeBarrierGeneration(grp_data);
+
+    return 0;
+}
+
+/**
+ * @brief Map one of the barrier's pages into the caller's address space
+ * 
+ * Each page is mapped on its own, entirely:
+ *      -BARRIER_STATE_PGOFF: the 'barrier_shared_t' structure, also writable
+ *      -BARRIER_COUNTERS_PGOFF: the 'barrier_counters_t' structure, read-only
+ * 
+ * @retval 0 on success
+ * @retval -EINVAL if the requested size or offset is wrong
+ * @retval -EACCES if the counters page is requested writable
+ * @retval -ENODEV if the group was uninstalled
+ */
+static int mmapGroupBarrier(struct file *filep, struct vm_area_struct *vma){
+    group_data *grp_data = fileGroup(filep);
+    void *page;
+    unsigned long pfn;
+
+    if(grp_data->flags.initialized == 0)
+        return -ENODEV;
+
+    if(vma->vm_end - vma->vm_start != PAGE_SIZE)
+        return -EINVAL;
+
+    switch(vma->vm_pgoff){
+        case BARRIER_STATE_PGOFF:
+            page = grp_data->barrier.shared;
+            break;
+
+        case BARRIER_COUNTERS_PGOFF:
+            if(vma->vm_flags & VM_WRITE)
+                return -EACCES;
+
+            //Prevent 'mprotect' from making the mapping writable later
+            #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+                vm_flags_clear(vma, VM_MAYWRITE);
+            #else
+                vma->vm_flags &= ~VM_MAYWRITE;
+            #endif
+
+            page = grp_data->barrier.counters;
+            break;
+
+        default:
+            return -EINVAL;
+    }
+
+    #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+        vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+    #else
+        vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+    #endif
+
+    pfn = virt_to_phys(page) >> PAGE_SHIFT;
+
+    return remap_pfn_range(vma, vma->vm_start, pfn, PAGE_SIZE, vma->vm_page_prot);
+}
 #endif
 
 
+/**
+ * @brief Stop all the activities of an unregistered group
+ * 
+ * Threads sleeping on the barrier are woken up and pending delayed messages
+ * are revoked, dropping the references they hold on the group. Files still
+ * open on the group keep it allocated until they are released.
+ * 
+ * @param[in] grp_data Pointer to the main structure of a group
+ * 
+ * @return nothing
+ */
+void shutdownGroup(group_data *grp_data){
+    #ifndef DISABLE_DELAYED_MSG
+        int revoked;
+    #endif
+
+    #ifndef DISABLE_THREAD_BARRIER
+        logGroup("Waking up all the sleeped thread 'group%d'", grp_data->group_id);
+        awakeBarrier(grp_data);
+    #endif
+
+    #ifndef DISABLE_DELAYED_MSG
+        revoked = revokeDelayedMessage(grp_data->msg_manager);
+        logGroup("Revoked %d delayed messages of 'group%d'", revoked, grp_data->group_id);
+    #endif
+
+    //Pollers will see the group uninstalled
+    wake_up_interruptible_all(&grp_data->msg_manager->read_wait);
+}
+
+
 /**
  * @brief Handler of group's ioctls requests
  * 
@@ -757,8 +1622,21 @@ void awakeBarrier(group_data *grp_data){
  *      -IOCTL_SET_SEND_DELAY: set the message delayed
  *      -IOCTL_REVOKE_DELAYED_MESSAGES: revoke delay on all queued messages
  *      -IOCTL_SLEEP_ON_BARRIER: The invoking thread will sleep until other thread awake the sleep queue
+ *      -IOCTL_SLEEP_ON_BARRIER_TIMEOUT: Same as above, but the sleep lasts at most the provided ms
  *      -IOCTL_AWAKE_BARRIER: Awake the sleep queue
+ *      -IOCTL_AWAKE_BARRIER_N: Awake at most N threads of the sleep queue, in FIFO order
+ *      -IOCTL_BARRIER_ARRIVE: Sleep until the number of parties of the barrier arrived
+ *      -IOCTL_SET_BARRIER_PARTIES: Set the number of parties of the counted barrier
+ *      -IOCTL_BARRIER_WAIT: Sleep if the barrier's generation equals the provided one
+ *      -IOCTL_BARRIER_WAKE: Wake up threads sleeping on a generation older than the current one
+ *      -IOCTL_BARRIER_REGISTER_EVENTFD: Signal the provided eventfd whenever the barrier is released
+ *      -IOCTL_BARRIER_UNREGISTER_EVENTFD: Remove a registration made through the same file
  *      -IOCTL_GET_GROUP_DESC: Write a group descriptor into the provided pointer
+ *      -IOCTL_GET_GROUP_STATS: Write the group's configuration and statistics into the provided 'group_snapshot_t'
+ *      -IOCTL_SHARE_HANDLE: Move the member of the file to a key owned by the file
+ *      -IOCTL_READ_MESSAGES: Read up to the provided number of messages, returns how many were read
+ *      -IOCTL_WRITE_MESSAGES: Write the provided messages, returns how many were written
+ *      -IOCTL_NEXT_MESSAGE_SIZE: Write the size of the next available message, returns 1 if there is none
  *      -IOCTL_SET_STRICT_MODE: Set the strict mode flag
  *      -IOCTL_CHANGE_OWNER: Change the owner of the group
  * 
@@ -774,6 +1652,13 @@ long int groupIoctl(struct file *filep, unsigned int ioctl_num, unsigned long io
     bool flag;
     uid_t new_owner;
 
+    grp_data = fileGroup(filep);
+
+    if(grp_data->flags.initialized == 0){
+        pr_err("Device still not initialized or deallocated, close and reopen the file descriptor");
+        return -1;
+    }
+
 
 	switch (ioctl_num){
         #ifndef DISABLE_DELAYED_MSG
@@ -783,49 +1668,90 @@ long int groupIoctl(struct file *filep, unsigned int ioctl_num, unsigned long io
                 if(delay < 0)   //Fix conversion issue
                     delay = 0;
 
-                grp_data = (group_data*) filep->private_data;
+                grp_data = fileGroup(filep);
 
                 atomic_long_set(&grp_data->msg_manager->message_delay, delay);
 
-                pr_info("Message Delay: delay set to: %ld", delay);
+                logDelay("Message Delay: delay set to: %ld", delay);
                 ret = 0;
                 break;
             case IOCTL_REVOKE_DELAYED_MESSAGES:
 
-                grp_data = (group_data*) filep->private_data;
+                grp_data = fileGroup(filep);
 
                 ret = revokeDelayedMessage(grp_data->msg_manager);
 
-                pr_info("Revoke Message: %d messages revoked from queue", ret);
+                logDelay("Revoke Message: %d messages revoked from queue", ret);
 
                 break;
             case IOCTL_CANCEL_DELAY:
 
-                grp_data = (group_data*) filep->private_data;
+                grp_data = fileGroup(filep);
 
                 ret = cancelDelay(grp_data->msg_manager);
 
-                pr_info("Cancelled delay of %d messages", ret);
+                logDelay("Cancelled delay of %d messages", ret);
 
                 break;
         #endif
         #ifndef DISABLE_THREAD_BARRIER
             case IOCTL_SLEEP_ON_BARRIER:
-                grp_data = (group_data*) filep->private_data;
-                printk(KERN_INFO "Sleeping call issued");
-                sleepOnBarrier(grp_data);
-                ret = 0;
+                grp_data = fileGroup(filep);
+                logBarrier("Sleeping call issued");
+                ret = sleepOnBarrier(grp_data);
+                break;
+            case IOCTL_SLEEP_ON_BARRIER_TIMEOUT:
+                ret = sleepOnBarrierTimeout(grp_data, (long)ioctl_param);
                 break;
             case IOCTL_AWAKE_BARRIER:
-                grp_data = (group_data*) filep->private_data;
-                printk(KERN_INFO "Awaking call issued");
+                grp_data = fileGroup(filep);
+                logBarrier("Awaking call issued");
                 awakeBarrier(grp_data);
                 ret = 0;
                 break;
+            case IOCTL_AWAKE_BARRIER_N:
+                awakeBarrierN(grp_data, (unsigned int)ioctl_param);
+                ret = 0;
+                break;
+            case IOCTL_BARRIER_WAIT:
+                ret = waitBarrierGeneration(grp_data, (u32)ioctl_param);
+                break;
+            case IOCTL_BARRIER_WAKE:
+                wakeBarrierGeneration(grp_data);
+                ret = 0;
+                break;
+            case IOCTL_BARRIER_REGISTER_EVENTFD:
+                ret = registerBarrierEventfd(grp_data, filep, (int)ioctl_param);
+                break;
+            case IOCTL_BARRIER_UNREGISTER_EVENTFD:
+            {
+                struct eventfd_ctx *ctx = eventfd_ctx_fdget((int)ioctl_param);
+
+                if(IS_ERR(ctx)){
+                    ret = PTR_ERR(ctx);
+                    break;
+                }
+
+                ret = unregisterBarrierEventfd(grp_data, filep, ctx) > 0 ? 0 : -ENOENT;
+                eventfd_ctx_put(ctx);
+                break;
+            }
+            case IOCTL_BARRIER_ARRIVE:
+                ret = arriveOnBarrier(grp_data);
+                break;
+            case IOCTL_SET_BARRIER_PARTIES:
+                if(grp_data->flags.strict_mode == 1 && !isOwner(grp_data)){
+                    printk(KERN_WARNING "Unable to set barrier parties: unauthorized");
+                    ret = -1;
+                    break;
+                }
+
+                ret = setBarrierParties(grp_data, (unsigned int)ioctl_param);
+                break;
         #endif
 
         case IOCTL_GET_GROUP_DESC:
-            grp_data = (group_data*) filep->private_data;
+            grp_data = fileGroup(filep);
 
             user_descriptor = (group_t*)ioctl_param;
 
@@ -837,8 +1763,30 @@ long int groupIoctl(struct file *filep, unsigned int ioctl_num, unsigned long io
             ret = 0;
             break;
 
+        case IOCTL_GET_GROUP_STATS:
+            grp_data = fileGroup(filep);
+
+            ret = copyGroupSnapshot(grp_data, (group_snapshot_t __user*)ioctl_param);
+            break;
+
+        case IOCTL_SHARE_HANDLE:
+            ret = shareHandle(filep);
+            break;
+
+        case IOCTL_READ_MESSAGES:
+            ret = sReadMessages(filep, (msg_batch_t __user*)ioctl_param);
+            break;
+
+        case IOCTL_WRITE_MESSAGES:
+            ret = sWriteMessages(filep, (msg_batch_t __user*)ioctl_param);
+            break;
+
+        case IOCTL_NEXT_MESSAGE_SIZE:
+            ret = sNextMessageSize(filep, (size_t __user*)ioctl_param);
+            break;
+
         case IOCTL_SET_STRICT_MODE:
-            grp_data = (group_data*) filep->private_data;
+            grp_data = fileGroup(filep);
 
             flag = (bool)ioctl_param;
 
@@ -851,7 +1799,7 @@ long int groupIoctl(struct file *filep, unsigned int ioctl_num, unsigned long io
             break;
         
         case IOCTL_CHANGE_OWNER:
-            grp_data = (group_data*) filep->private_data;
+            grp_data = fileGroup(filep);
 
             new_owner = (uid_t)ioctl_param;
 
@@ -864,7 +1812,7 @@ long int groupIoctl(struct file *filep, unsigned int ioctl_num, unsigned long io
             break;
 
 	default:
-		printk(KERN_INFO "Invalid IOCTL command provided: \n\tioctl_num=%u\n\tparam: %lu", ioctl_num, ioctl_param);
+		logGroup("Invalid IOCTL command provided: \n\tioctl_num=%u\n\tparam: %lu", ioctl_num, ioctl_param);
 		ret = INVALID_IOCTL_COMMAND;
 		break;
 	}
@@ -891,7 +1839,7 @@ __must_check int copy_group_t_from_user(__user group_t *user_group, group_t *ker
 		char *group_name_tmp;
 
 		if(!access_ok(user_group, sizeof(group_t))){
-			pr_debug("Unable to read user-space memory");
+			logGroup("Unable to read user-space memory");
 			return MEM_ACCESS_ERR;
 		}
 
@@ -903,7 +1851,7 @@ __must_check int copy_group_t_from_user(__user group_t *user_group, group_t *ker
 
 
 		if(!access_ok(kern_group->group_name, sizeof(char)*kern_group->name_len)){
-			pr_debug("Unable to read user-space group's name memory");
+			logGroup("Unable to read user-space group's name memory");
 			return MEM_ACCESS_ERR;
 		}
 
@@ -945,7 +1893,7 @@ __must_check int copy_group_t_to_user(__user group_t *user_group, group_t *kern_
 
         //Check user-space memory access
 		if(!access_ok(user_group, sizeof(group_t))){
-			pr_debug("Unable to write user-space memory");
+			logGroup("Unable to write user-space memory");
 			return MEM_ACCESS_ERR;
 		}
 
@@ -23,9 +23,12 @@
 #include <linux/idr.h>
 #include <linux/errno.h>
 #include <linux/cred.h>    //For current_uid()
+#include <linux/mm.h>      //For remap_pfn_range()
+#include <linux/version.h>
 
 
 #include "message.h"
+#include "stats.h"
 
 /*------------------------------------------------------------------------------
 	Error Codes
@@ -44,7 +47,7 @@
 
 
 
-#define GROUP_MAX_MINORS    255
+#define GROUP_MAX_MINORS    (1 << 16)      /**< Size of the group devices minor range */
 #define DEVICE_NAME_SIZE    64
 
 #define DEFAULT_MSG_SIZE 256
@@ -53,6 +56,11 @@
 //IOCTLS
 
 #define IOCTL_GET_GROUP_DESC _IOR('Q', 1, group_t*)
+#define IOCTL_GET_GROUP_STATS _IOWR('Q', 2, group_snapshot_t*)
+#define IOCTL_SHARE_HANDLE _IO('Q', 3)
+#define IOCTL_READ_MESSAGES _IOWR('Q', 4, msg_batch_t*)
+#define IOCTL_WRITE_MESSAGES _IOW('Q', 5, msg_batch_t*)
+#define IOCTL_NEXT_MESSAGE_SIZE _IOR('Q', 6, size_t)
 #define IOCTL_SET_STRICT_MODE _IOW('Q', 101, bool)
 #define IOCTL_CHANGE_OWNER _IOW('Q', 102, uid_t)
 
@@ -69,6 +77,18 @@
 
     #define IOCTL_SLEEP_ON_BARRIER _IO('Z', 0)
     #define IOCTL_AWAKE_BARRIER _IO('Z', 1)
+    #define IOCTL_BARRIER_ARRIVE _IO('Z', 2)
+    #define IOCTL_SET_BARRIER_PARTIES _IOW('Z', 3, unsigned int)
+    #define IOCTL_SLEEP_ON_BARRIER_TIMEOUT _IOW('Z', 4, long)
+    #define IOCTL_AWAKE_BARRIER_N _IOW('Z', 5, unsigned int)
+    #define IOCTL_BARRIER_WAIT _IOW('Z', 6, unsigned int)
+    #define IOCTL_BARRIER_WAKE _IO('Z', 7)
+    #define IOCTL_BARRIER_REGISTER_EVENTFD _IOW('Z', 8, int)
+    #define IOCTL_BARRIER_UNREGISTER_EVENTFD _IOW('Z', 9, int)
+
+    #define BARRIER_SERIAL_THREAD   1       /**< Returned to the thread that released a counted barrier */
+    #define BARRIER_TIMED_OUT       2       /**< Returned when a timed sleep expires before an awake */
+    #define BARRIER_NOT_SET         -30     /**< Returned when arriving on a barrier without parties */
 
 #endif
 
@@ -86,10 +106,34 @@ static ssize_t readGroupMessage(struct file *file, char __user *user_buffer, siz
 static ssize_t writeGroupMessage(struct file *filep, const char __user *buf, size_t count, loff_t *f_pos);
 static long int groupIoctl(struct file *filep, unsigned int ioctl_num, unsigned long ioctl_param);
 static int flushGroupMessage(struct file *filep, fl_owner_t id);
+static __poll_t pollGroup(struct file *filep, poll_table *wait);
+#ifndef DISABLE_THREAD_BARRIER
+    static int mmapGroupBarrier(struct file *filep, struct vm_area_struct *vma);
+#endif
 
 
 inline void initParticipants(group_data *grp_data);
+
+/** @brief Group of an open group device file*/
+static inline group_data *fileGroup(struct file *filep){
+    return ((group_file_t*)filep->private_data)->group;
+}
+
+/**
+ * @brief Key of the member on whose behalf the caller is acting
+ * 
+ * @note For a shared handle the key is the one of the file, otherwise it is
+ *      the PID of the calling thread
+ */
+static inline pid_t fileMember(struct file *filep){
+    group_file_t *gfile = filep->private_data;
+
+    return smp_load_acquire(&gfile->shared) ? READ_ONCE(gfile->member) : current->pid;
+}
+
 int installGroupClass(void);
+int registerGroupRegion(void);
+void unregisterGroupRegion(void);
 
 static struct file_operations group_operation = {
     .owner = THIS_MODULE,
@@ -98,14 +142,28 @@ static struct file_operations group_operation = {
     .write = writeGroupMessage,
     .release = releaseGroup,
     .flush = flushGroupMessage,
+    .poll = pollGroup,
+    #ifndef DISABLE_THREAD_BARRIER
+        .mmap = mmapGroupBarrier,
+    #endif
     .unlocked_ioctl = groupIoctl
 };
 
 
 extern struct class *group_device_class;
 
-int registerGroupDevice(group_data *grp_data, struct device* parent);
-void unregisterGroupDevice(group_data *grp_data, bool flag);
+int registerGroupDevice(group_data *grp_data, struct device* parent, const group_config_t *config);
+#ifndef DISABLE_THREAD_BARRIER
+    int setBarrierParties(group_data *grp_data, const unsigned int parties);
+    int registerBarrierEventfd(group_data *grp_data, struct file *filep, const int fd);
+    int unregisterBarrierEventfd(group_data *grp_data, struct file *filep, struct eventfd_ctx *ctx);
+#endif
+bool getGroup(group_data *grp_data);
+void putGroup(group_data *grp_data);
+group_data *findGroup(const int group_id);     //Defined in 'main_device.c'
+void unregisterGroupDevice(group_data *grp_data);
+void shutdownGroup(group_data *grp_data);
+bool isOwner(group_data *grp_data);
 int copy_group_t_from_user(__user group_t *user_group, group_t *kern_group);
 
 #endif //GRP_MAN_H
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "log.h"
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+
+
+DEFINE_STATIC_KEY_FALSE(log_message_key);
+DEFINE_STATIC_KEY_FALSE(log_delay_key);
+DEFINE_STATIC_KEY_FALSE(log_gc_key);
+DEFINE_STATIC_KEY_FALSE(log_barrier_key);
+DEFINE_STATIC_KEY_FALSE(log_sysfs_key);
+DEFINE_STATIC_KEY_FALSE(log_group_key);
+
+
+/** @brief Static keys of the subsystems, the index is the bit of the subsystem in 'log_mask'*/
+static struct static_key_false *log_keys[] = {
+    &log_message_key,
+    &log_delay_key,
+    &log_gc_key,
+    &log_barrier_key,
+    &log_sysfs_key,
+    &log_group_key,
+};
+
+static unsigned int log_mask;     /**< Subsystems whose logging is enabled*/
+
+
+/**
+ * @brief Set the 'log_mask' parameter and switch the static keys accordingly
+ * 
+ * @note Called with the module's parameter lock held, so concurrent writes 
+ *      are serialised
+ * 
+ * @retval 0 on success
+ * @retval -EINVAL if the value is not a number or contains unknown bits
+ */
+static int sSetLogMask(const char *val, const struct kernel_param *kp){
+    unsigned int mask;
+    int i;
+
+    if(kstrtouint(val, 0, &mask) < 0 || (mask & ~LOG_ALL) != 0)
+        return -EINVAL;
+
+    for(i = 0; i < ARRAY_SIZE(log_keys); i++){
+        if(mask & (1 << i))
+            static_branch_enable(log_keys[i]);
+        else
+            static_branch_disable(log_keys[i]);
+    }
+
+    log_mask = mask;
+
+    return 0;
+}
+
+static const struct kernel_param_ops log_mask_ops = {
+    .set = sSetLogMask,
+    .get = param_get_uint,
+};
+
+module_param_cb(log_mask, &log_mask_ops, &log_mask, 0644);
+MODULE_PARM_DESC(log_mask, "Subsystems with diagnostic logging enabled: 1 message, 2 delay, 4 gc, 8 barrier, 16 sysfs, 32 group");
@@ -0,0 +1,60 @@
+/**
+ * @file log.h
+ * @brief Diagnostic logging of the module, gated by static keys
+ * 
+ * Each subsystem has its own static key, so a disabled log statement costs a
+ * patched-out branch and its arguments are never evaluated nor formatted.
+ * Keys are switched at runtime through the 'log_mask' module parameter, by 
+ * OR-ing the 'LOG_*' bits of the subsystems to enable, e.g.:
+ * 
+ *      echo 9 > /sys/module/aosv2020/parameters/log_mask     (message and barrier)
+ * 
+ * Messages are printed with the KERN_DEBUG level. Errors and warnings are not
+ * diagnostic messages and are still printed with 'pr_err'/'pr_warn'.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+
+#include <linux/kernel.h>
+#include <linux/printk.h>
+#include <linux/jump_label.h>
+
+
+#define LOG_MESSAGE     (1 << 0)    /**< Message queue, reads and writes*/
+#define LOG_DELAY       (1 << 1)    /**< Delayed messages*/
+#define LOG_GC          (1 << 2)    /**< Garbage collector*/
+#define LOG_BARRIER     (1 << 3)    /**< Thread barrier*/
+#define LOG_SYSFS       (1 << 4)    /**< sysfs and debugfs interfaces*/
+#define LOG_GROUP       (1 << 5)    /**< Installation, opening and ownership of groups*/
+
+#define LOG_ALL         (LOG_MESSAGE | LOG_DELAY | LOG_GC | LOG_BARRIER | LOG_SYSFS | LOG_GROUP)
+
+
+DECLARE_STATIC_KEY_FALSE(log_message_key);
+DECLARE_STATIC_KEY_FALSE(log_delay_key);
+DECLARE_STATIC_KEY_FALSE(log_gc_key);
+DECLARE_STATIC_KEY_FALSE(log_barrier_key);
+DECLARE_STATIC_KEY_FALSE(log_sysfs_key);
+DECLARE_STATIC_KEY_FALSE(log_group_key);
+
+
+/**
+ * @brief Print a diagnostic message if the static key of its subsystem is enabled
+ */
+#define synchLog(key, fmt, ...)                                         \
+    do{                                                                 \
+        if(static_branch_unlikely(&(key)))                              \
+            printk(KERN_DEBUG pr_fmt(fmt), ##__VA_ARGS__);              \
+    }while(0)
+
+#define logMessage(fmt, ...)    synchLog(log_message_key, fmt, ##__VA_ARGS__)
+#define logDelay(fmt, ...)      synchLog(log_delay_key, fmt, ##__VA_ARGS__)
+#define logGc(fmt, ...)         synchLog(log_gc_key, fmt, ##__VA_ARGS__)
+#define logBarrier(fmt, ...)    synchLog(log_barrier_key, fmt, ##__VA_ARGS__)
+#define logSysfs(fmt, ...)      synchLog(log_sysfs_key, fmt, ##__VA_ARGS__)
+#define logGroup(fmt, ...)      synchLog(log_group_key, fmt, ##__VA_ARGS__)
+
+
+#endif //LOG_H
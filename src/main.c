@@ -14,6 +14,9 @@
 
 #include "main_device.h"
 
+#define CREATE_TRACE_POINTS
+#include "synch_trace.h"
+
 
 static int mainStart(void);
 static void mainStop(void);
@@ -11,10 +11,59 @@ static struct file_operations main_fops = {
 };
 
 
-int getGroupID(const group_t new_group);
 int copy_group_t_from_user(__user group_t *user_group, group_t *kern_group);
 
 
+/**
+ * @brief Hash a 'group_t' key of the group name table
+ */
+static u32 groupNameHash(const void *data, u32 len, u32 seed){
+	const group_t *key = data;
+
+	return jhash(key->group_name, key->name_len, seed);
+}
+
+/**
+ * @brief Hash a 'group_data' object of the group name table
+ */
+static u32 groupObjHash(const void *data, u32 len, u32 seed){
+	const group_data *grp_data = data;
+
+	return groupNameHash(&grp_data->descriptor, len, seed);
+}
+
+/**
+ * @brief Compare a 'group_t' key with the descriptor of a 'group_data' object
+ * 
+ * @retval 0 if the names are equal
+ * @retval non-zero otherwise
+ */
+static int groupNameCmp(struct rhashtable_compare_arg *arg, const void *obj){
+	const group_t *key = arg->key;
+	const group_data *grp_data = obj;
+
+	if(key->name_len != grp_data->descriptor.name_len)
+		return 1;
+
+	return memcmp(key->group_name, grp_data->descriptor.group_name, key->name_len);
+}
+
+/** 
+ * @brief Parameters of the group name table
+ * 
+ * The key of an entry is its 'descriptor' field, so both lookups and inserts
+ * compare 'group_t' structures
+ */
+static const struct rhashtable_params group_names_params = {
+	.head_offset = offsetof(group_data, name_node),
+	.key_offset = offsetof(group_data, descriptor),
+	.hashfn = groupNameHash,
+	.obj_hashfn = groupObjHash,
+	.obj_cmpfn = groupNameCmp,
+	.automatic_shrinking = true,
+};
+
+
 /**
  * @brief Kernel Module Init
  *
@@ -40,7 +89,119 @@ int mainInit(void){
 		return ret;
 	}
 
-	initializeMainDevice();
+	if((ret = initializeMainDevice()) < 0){
+		sUnregisterMainDev();
+		return ret;
+	}
+
+	//Device numbers shared by all the groups
+	if((ret = registerGroupRegion()) < 0){
+		rhashtable_destroy(&main_device_data.group_names);
+		sUnregisterMainDev();
+		return ret;
+	}
+
+	#ifndef DISABLE_DELAYED_MSG
+		if((ret = initDelayedQueue()) < 0){
+			unregisterGroupRegion();
+			rhashtable_destroy(&main_device_data.group_names);
+			sUnregisterMainDev();
+			return ret;
+		}
+	#endif
+
+	initStatsRoot();
+
+	//The status file is optional, groups can still be inspected through sysfs
+	status_entry = proc_create_single(PROC_STATUS_NAME, S_IRUGO, NULL, sGroupsStatusShow);
+	if(!status_entry)
+		pr_warn("Unable to create /proc/%s", PROC_STATUS_NAME);
+
+	return 0;
+}
+
+/**
+ * @brief Add the values of a group to the module's totals
+ */
+static void sAddGroupTotals(group_snapshot_t *total, const group_snapshot_t *snapshot){
+	total->members += snapshot->members;
+	total->queue_depth += snapshot->queue_depth;
+	total->current_storage_size += snapshot->current_storage_size;
+	total->max_storage_size += snapshot->max_storage_size;
+	total->delayed_depth += snapshot->delayed_depth;
+
+	total->counters.msg_written += snapshot->counters.msg_written;
+	total->counters.bytes_written += snapshot->counters.bytes_written;
+	total->counters.msg_read += snapshot->counters.msg_read;
+	total->counters.bytes_read += snapshot->counters.bytes_read;
+	total->counters.msg_rejected += snapshot->counters.msg_rejected;
+	total->counters.msg_delayed += snapshot->counters.msg_delayed;
+	total->counters.msg_revoked += snapshot->counters.msg_revoked;
+	total->counters.msg_reclaimed += snapshot->counters.msg_reclaimed;
+}
+
+/**
+ * @brief Print the status of all the installed groups in the module's /proc file
+ * 
+ * One line is printed for each group, followed by a line with the module-wide 
+ * totals. The IDR is walked under RCU and each group is pinned with a reference 
+ * while its values are collected, so a read never blocks installs and removals,
+ * and a group removed during the walk is either printed entirely or skipped.
+ * 
+ * @note Storage sizes are in bytes, the delay is the number of messages in the delayed queue
+ */
+static int sGroupsStatusShow(struct seq_file *m, void *v){
+	group_snapshot_t snapshot, total;
+	group_data *grp_data;
+	unsigned int groups = 0;
+	int id;
+	bool pinned;
+
+	memset(&total, 0, sizeof(group_snapshot_t));
+
+	seq_puts(m, "id name owner members queue_depth storage_size max_storage_size delayed "
+				"msg_written bytes_written msg_read bytes_read msg_rejected msg_delayed msg_revoked msg_reclaimed\n");
+
+	for(id = GRP_MIN_ID; ; id++){
+
+		rcu_read_lock();
+			grp_data = idr_get_next(&main_device_data.group_map, &id);
+			pinned = grp_data && getGroup(grp_data);
+		rcu_read_unlock();
+
+		if(!grp_data)
+			break;
+
+		//Skip groups that are being installed or released
+		if(!pinned)
+			continue;
+
+		if(grp_data->flags.initialized == 1){
+			fillGroupSnapshot(grp_data, &snapshot);
+			sAddGroupTotals(&total, &snapshot);
+			groups++;
+
+			seq_printf(m, "%d %.*s %u %u %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n",
+				grp_data->group_id, (int)grp_data->descriptor.name_len, grp_data->descriptor.group_name,
+				snapshot.owner, snapshot.members, snapshot.queue_depth,
+				snapshot.current_storage_size, snapshot.max_storage_size, snapshot.delayed_depth,
+				snapshot.counters.msg_written, snapshot.counters.bytes_written,
+				snapshot.counters.msg_read, snapshot.counters.bytes_read,
+				snapshot.counters.msg_rejected, snapshot.counters.msg_delayed,
+				snapshot.counters.msg_revoked, snapshot.counters.msg_reclaimed);
+		}
+
+		putGroup(grp_data);
+		cond_resched();
+	}
+
+	seq_printf(m, "total %u - %u %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n",
+		groups, total.members, total.queue_depth,
+		total.current_storage_size, total.max_storage_size, total.delayed_depth,
+		total.counters.msg_written, total.counters.bytes_written,
+		total.counters.msg_read, total.counters.bytes_read,
+		total.counters.msg_rejected, total.counters.msg_delayed,
+		total.counters.msg_revoked, total.counters.msg_reclaimed);
 
 	return 0;
 }
@@ -58,34 +219,44 @@ void mainExit(void){
 
 	printk(KERN_INFO "%s unloading ...\n", D_DEV_NAME);
 
+	//Waits for the current readers, that hold references on the groups they are printing
+	proc_remove(status_entry);
+
 
 	printk(KERN_INFO "Starting deallocating group devices...");
 
-	idr_for_each_entry(&main_device_data.group_map, cursor, id_cursor){
-		unregisterGroupDevice(cursor, false);	
-		printk(KERN_INFO "Phase 1- Device %s destroyed", cursor->descriptor.group_name);
-	}
+	down(&main_device_data.sem);
+		idr_for_each_entry(&main_device_data.group_map, cursor, id_cursor){
+			sRemoveGroup(cursor);
+			shutdownGroup(cursor);
+			putGroup(cursor);	//Drop the install reference
+			printk(KERN_INFO "Device group%d destroyed", id_cursor);
+		}
+	up(&main_device_data.sem);
 
 	class_destroy(group_device_class);
 	printk(KERN_INFO "Group class destroyed");
 
-	idr_for_each_entry(&main_device_data.group_map, cursor, id_cursor){
-		unregisterGroupDevice(cursor, true);	
-		printk(KERN_INFO "Phase 2- Device %s destroyed", cursor->descriptor.group_name);
-		
-			#ifndef DISABLE_SYSFS
-				if(cursor->flags.sysfs_loaded == 1){
-					pr_debug("Releasing sysfs for group %d", id_cursor);
-					releaseSysFs(&cursor->group_sysfs);
-				}
-			#endif
-		kfree(cursor);	//Deallocate group_data structure
-	}
+	releaseStatsRoot();
+
+	#ifndef DISABLE_DELAYED_MSG
+		//Wait for deliveries that were already running
+		releaseDelayedQueue();
+	#endif
+
+	//Wait for the deferred deallocation of group structures
+	rcu_barrier();
 
 
 	//Deallocate the IDR
 	idr_destroy(&main_device_data.group_map);
-	pr_debug("IDR destroyed");
+	logGroup("IDR destroyed");
+
+	rhashtable_destroy(&main_device_data.group_names);
+	logGroup("Group name table destroyed");
+
+	unregisterGroupRegion();
+	logGroup("Group region deallocated");
 
 
 
@@ -99,16 +270,24 @@ void mainExit(void){
 /**
  * 	@brief Init Main Device members
  * 	@param nothing
- * 	@retval nothing
+ * 	@retval 0 on success
+ * 	@retval HASH_INIT_ERR if the group name table cannot be allocated
  * 
  * 	@note If a new structure is addedd to 't_main_sync' all init 
  *  	procedures should be perfomed here
  */
-void initializeMainDevice(void){
-	pr_debug("Initializing groups list...");
+int initializeMainDevice(void){
+	logGroup("Initializing groups list...");
 
 	idr_init(&main_device_data.group_map);	//Init group IDR
 	sema_init(&main_device_data.sem, 1);	//Init main device semaphore
+
+	if(rhashtable_init(&main_device_data.group_names, &group_names_params) < 0){
+		pr_err("Unable to initialize the group name table");
+		return HASH_INIT_ERR;
+	}
+
+	return 0;
 }
 
 
@@ -126,7 +305,7 @@ void initializeMainDevice(void){
  * @retval others	failure
  */
 static int mainOpen(struct inode *inode, struct file *filep){
-	printk(KERN_INFO "%s opening ...\n", D_DEV_NAME);
+	logGroup("%s opening ...\n", D_DEV_NAME);
 
 	//Store data into 'device_info' (kept per device)
 	//filep->device_info = main_device_data;
@@ -150,7 +329,7 @@ static int mainRelease(struct inode *inode, struct file *filep)
 {
 	//T_MAIN_SYNC *info = (T_MAIN_SYNC *)filep->device_info;
 
-	printk(KERN_INFO "%s releasing ...\n", D_DEV_NAME);
+	logGroup("%s releasing ...\n", D_DEV_NAME);
 
 	/* deallocate private data */
 	//kfree(info);
@@ -175,6 +354,10 @@ static ssize_t mainWrite(struct file *filep, const char __user *buf, size_t coun
 
 /**
  * @brief Kernel Module Read : read()
+ * 
+ * Copies the name of the first installed group whose ID is greater or equal
+ * than the file position, then moves the position after that ID. Subsequent
+ * reads therefore enumerate all the installed groups.
  *
  * @param [in]		filep	file structure
  * @param [out]		buf		buffer address (user)
@@ -183,39 +366,47 @@ static ssize_t mainWrite(struct file *filep, const char __user *buf, size_t coun
  *
  * @bug Experimental feature
  * 
- * @return	number of read byte
+ * @return	number of read byte, 0 if no other group is installed
  */
 static ssize_t mainRead(struct file *filep, char __user *buf, size_t count, loff_t *f_pos){
 
 	int group_id;
 	group_data *grp_data;
-	group_t descriptor;
 	size_t len;
 
-	group_id = (int) *f_pos;
+	if(*f_pos < 0 || *f_pos >= GRP_MAX_ID)
+		return 0;
 
-	if(group_id < 0 ){
-		printk(KERN_INFO "mainRead: conversion error, exiting...");
-		return -1;
-	}
+	group_id = (int) *f_pos;
 
-	printk(KERN_INFO "mainRead: readed f_pos value: %ud", group_id);
+	logGroup("mainRead: readed f_pos value: %d", group_id);
 
-	down(&main_device_data.sem);
-		grp_data = idr_get_next(&main_device_data.group_map, &group_id);
-	up(&main_device_data.sem);
+	//Lock-less lookup of the next group which is not being released
+	rcu_read_lock();
+		while((grp_data = idr_get_next(&main_device_data.group_map, &group_id)) != NULL){
+			if(getGroup(grp_data))
+				break;
+			group_id++;
+		}
+	rcu_read_unlock();
 
+	if(grp_data == NULL)
+		return 0;
 
-	descriptor = grp_data->descriptor;
 
-	len = descriptor.name_len;
-	
+	len = min_t(size_t, count, grp_data->descriptor.name_len);
 
-	if( copy_to_user(buf, descriptor.group_name, len) > 0){
+	if( copy_to_user(buf, grp_data->descriptor.group_name, len) > 0){
 		printk(KERN_ERR "mainRead: Unable to copy memory to user");
+		putGroup(grp_data);
+		return -EFAULT;
 	}
 
-	return 0;
+	putGroup(grp_data);
+
+	*f_pos = group_id + 1;
+
+	return len;
 }
 
 /*------------------------------------------------------------------------------
@@ -295,14 +486,14 @@ static void sUnregisterMainDev(void){
 	cdev_del(&main_device_data.cdev);
 	/* destroy device node */
 	device_destroy(main_class, main_device_data.dev);
-	pr_debug("Main device destroyed");
+	logGroup("Main device destroyed");
 
 	/* destroy device class */
 	class_destroy(main_class);
-	pr_debug("Main class destroryed");
+	logGroup("Main class destroryed");
 
 	unregister_chrdev_region(main_device_data.dev, 1);
-	pr_debug("Char device region deallocated");
+	logGroup("Char device region deallocated");
 }
 
 
@@ -314,6 +505,8 @@ static void sUnregisterMainDev(void){
  * 			structure, returns GROUP_EXISTS if the group already exists
  *	-IOCTL_GET_GROUP_ID: returns the ID corresponding to the provided 'group_t' structure
  * 			or -1 if the group does not exists
+ *	-IOCTL_UNINSTALL_GROUP: removes the group with the provided ID, see 'uninstallGroup'
+ *	-IOCTL_INSTALL_GROUPS: installs an array of configured groups, see 'installGroups'
  * 
  */
 static long int mainDeviceIoctl(struct file *file, unsigned int ioctl_num, unsigned long ioctl_param){
@@ -329,22 +522,21 @@ static long int mainDeviceIoctl(struct file *file, unsigned int ioctl_num, unsig
 			return USER_COPY_ERR;
 		}
 
-		if(getGroupID(group_tmp) >= 0){
+		logGroup("Installing group [%.*s]...", (int)group_tmp.name_len, group_tmp.group_name);
+		ret = installGroup(group_tmp, NULL);
+
+		if(ret == GROUP_EXISTS){
 			printk(KERN_WARNING "The group already exists!!!");
-			return GROUP_EXISTS;
+			return ret;
 		}
 
-
-		pr_debug("Installing group [%s]...", group_tmp.group_name);
-		ret = installGroup(group_tmp);
-
 		if(ret < 0){
 			pr_err("Unable to install a group, exiting");
 			return ret;
 		}
 
 
-		pr_info("Group [%s] installed correctly", group_tmp.group_name);
+		logGroup("Group %d installed correctly", ret);
 
 		break;
 	
@@ -356,11 +548,38 @@ static long int mainDeviceIoctl(struct file *file, unsigned int ioctl_num, unsig
 			return USER_COPY_ERR;
 		}
 
-		pr_debug("Group name: %s\nLen: %ld", group_tmp.group_name, group_tmp.name_len);
+		logGroup("Group name: %.*s\nLen: %ld", (int)group_tmp.name_len, group_tmp.group_name, group_tmp.name_len);
 
 		ret = getGroupID(group_tmp);
+		kfree(group_tmp.group_name);	//The lookup key is no longer needed
+
+		logGroup("Fetched Group ID: %d", ret);
+
+		break;
+
+	case IOCTL_UNINSTALL_GROUP:
+
+		ret = uninstallGroup((int)ioctl_param);
+
+		if(ret < 0){
+			pr_err("Unable to uninstall group %d: %d", (int)ioctl_param, ret);
+			return ret;
+		}
 
-		pr_debug("Fetched Group ID: %d", ret);
+		logGroup("Group %d uninstalled", (int)ioctl_param);
+
+		break;
+
+	case IOCTL_INSTALL_GROUPS:
+
+		ret = installGroups((group_install_t __user*)ioctl_param);
+
+		if(ret < 0){
+			pr_err("Unable to process the install request: %d", ret);
+			return ret;
+		}
+
+		logGroup("%d groups installed", ret);
 
 		break;
 
@@ -374,46 +593,105 @@ static long int mainDeviceIoctl(struct file *file, unsigned int ioctl_num, unsig
 	return ret;
 }
 
+/**
+ * @brief Check a group configuration and replace unset values with defaults
+ * 
+ * @param[in]	config	The configuration requested by the user, may be NULL
+ * @param[out]	dest	The configuration to apply to the group
+ * 
+ * @retval 0 on success
+ * @retval INVALID_CONFIG_ERR if some value is out of range
+ */
+static int sCheckGroupConfig(const group_config_t *config, group_config_t *dest){
+
+	if(!config){
+		memset(dest, 0, sizeof(group_config_t));
+		dest->garbage_collector_ratio = DEFAULT_GC_RATIO;
+	}else{
+		*dest = *config;
+	}
+
+	if(dest->max_message_size == 0)
+		dest->max_message_size = DEFAULT_MSG_SIZE;
+	if(dest->max_storage_size == 0)
+		dest->max_storage_size = DEFAULT_STORAGE_SIZE;
+
+	if(dest->garbage_collector_ratio < 0 || dest->garbage_collector_ratio > MAX_GC_RATIO)
+		return INVALID_CONFIG_ERR;
+	if(dest->message_delay < 0)
+		return INVALID_CONFIG_ERR;
+	if(dest->max_message_size > dest->max_storage_size)
+		return INVALID_CONFIG_ERR;
+
+	return 0;
+}
+
+
 /**
  * @brief Install a group for the provided 'group_t' descriptor
  * 
  * @param[in]	new_group_descriptor	The group descriptor
+ * @param[in]	config					Initial configuration of the group, NULL for defaults
  * 
  * @retval The installed group's ID
  * @retval ALLOC_ERR if some memory allocation fails
  * @retval IDR_ERR If the IDR fails to allocate the ID
+ * @retval GROUP_EXISTS If a group with the same name is already installed
+ * @retval INVALID_CONFIG_ERR If the configuration contains invalid values
  * 
+ * @note The group takes ownership of the descriptor's name buffer, which is
+ * 		released with the group structure (or immediately on failure)
  * @note For error codes meaning see 'main_device.h'
  */
 
-__must_check int installGroup(const group_t new_group_descriptor){
+__must_check int installGroup(const group_t new_group_descriptor, const group_config_t *config){
 
 	group_data *new_group;
-	int group_id;
+	group_config_t group_config;
 	int ret = 0;
 
+	if((ret = sCheckGroupConfig(config, &group_config)) < 0){
+		kfree(new_group_descriptor.group_name);
+		return ret;
+	}
+
 	new_group = (group_data*)kmalloc(sizeof(group_data), GFP_KERNEL);
 
-	if(!new_group)
+	if(!new_group){
+		kfree(new_group_descriptor.group_name);
 		return ALLOC_ERR;
+	}
 
 
 	memset(&new_group->flags, 0, sizeof(g_flags_t));	//Reset all flags
+	new_group->flags.strict_mode = group_config.strict_mode;
+	new_group->flags.garbage_collector_disabled = group_config.garbage_collector_disabled;
+	new_group->flags.gc_include_struct = group_config.include_struct_size;
+
+	kref_init(&new_group->refcount);	//Reference held by the IDR
+	new_group->msg_manager = NULL;
+	new_group->stats.counters = NULL;
+	new_group->stats.delivery_latency = NULL;
+	new_group->stats.release_latency = NULL;
+	new_group->stats.locks = NULL;
+	#ifndef DISABLE_THREAD_BARRIER
+		new_group->barrier.shared = NULL;
+	#endif
 
 	new_group->descriptor = new_group_descriptor;
 	new_group->owner = current_uid().val;
 	init_rwsem(&new_group->owner_lock);
 
 
-	pr_debug("Group descriptor: [%s]", new_group->descriptor.group_name);
+	logGroup("Group descriptor: [%.*s]", (int)new_group->descriptor.name_len, new_group->descriptor.group_name);
 
 
 	//Allocate ID
-	pr_debug("Allocating IDR");
+	logGroup("Allocating IDR");
 	down(&main_device_data.sem);
 		new_group->group_id  = idr_alloc(&main_device_data.group_map, new_group, GRP_MIN_ID, GRP_MAX_ID, GFP_KERNEL);
 	up(&main_device_data.sem);
-	pr_debug("Allocated IDR number %d", new_group->group_id);
+	logGroup("Allocated IDR number %d", new_group->group_id);
 
 	if(new_group->group_id  < 0){
 		pr_err("Unable to allocate ID for the new group");
@@ -421,41 +699,189 @@ __must_check int installGroup(const group_t new_group_descriptor){
 		goto cleanup;
 	}
 
-	pr_debug("Registering Group device...");
-	ret = registerGroupDevice(new_group, main_device);
+	//Reserve the name, this fails atomically if the group already exists
+	ret = rhashtable_lookup_insert_fast(&main_device_data.group_names, &new_group->name_node, group_names_params);
+
+	if(ret == -EEXIST){
+		ret = GROUP_EXISTS;
+		goto cleanup_id;
+	}else if(ret < 0){
+		pr_err("Unable to index the group name: %d", ret);
+		ret = ALLOC_ERR;
+		goto cleanup_id;
+	}
+
+	logGroup("Registering Group device...");
+	ret = registerGroupDevice(new_group, main_device, &group_config);
 
 	if(ret != 0){
 		printk(KERN_ERR "Error: %d", ret);
-		goto cleanup;
+		goto cleanup_name;
 	}
 
 
 	#ifndef DISABLE_SYSFS
 		if((ret = initSysFs(new_group)) < 0 ){
 			printk(KERN_ERR "Unable to initialize the sysfs interface");
-			goto cleanup;
+			unregisterGroupDevice(new_group);
+			goto cleanup_name;
 		}
 
 		new_group->flags.sysfs_loaded = 1;
 	#endif
 
+	registerGroupDebugfs(new_group);
+
 	new_group->flags.initialized = 1;
 
 	return new_group->group_id;	//Return the new group ID
 
 
-	cleanup:
-		//Free memory
-		kfree(new_group);
+	cleanup_name:
+		rhashtable_remove_fast(&main_device_data.group_names, &new_group->name_node, group_names_params);
+	cleanup_id:
 		down(&main_device_data.sem);
-			idr_remove(&main_device_data.group_map, group_id);
+			idr_remove(&main_device_data.group_map, new_group->group_id);
 		up(&main_device_data.sem);
+	cleanup:
+		//Concurrent lookups may still reference the group, the last one frees it
+		putGroup(new_group);
 		return ret;
 }
 
+/**
+ * @brief Install all the groups specified in a 'group_install_t' request
+ * 
+ * Each specification is processed independently: the ID of the installed
+ * group (or the error code) is written back into its 'group_id' field, so a
+ * failure does not prevent the installation of the following groups.
+ * 
+ * @param[in,out]	request	User-space pointer to the request
+ * 
+ * @retval The number of groups installed
+ * @retval USER_COPY_ERR if the request cannot be accessed
+ * 
+ * @note Installation stops early if the calling process receives a fatal signal
+ */
+int installGroups(group_install_t __user *request){
+	group_install_t batch;
+	group_spec_t spec;
+	group_t descriptor;
+	size_t i;
+	int installed = 0;
+	int ret;
+
+	if(copy_from_user(&batch, request, sizeof(group_install_t)))
+		return USER_COPY_ERR;
+
+	for(i = 0; i < batch.count; i++){
+
+		if(fatal_signal_pending(current))
+			break;
+
+		if(copy_from_user(&spec, &batch.specs[i], sizeof(group_spec_t)))
+			return USER_COPY_ERR;
+
+		ret = copy_group_t_from_user(&batch.specs[i].descriptor, &descriptor);
+
+		if(ret == 0)
+			ret = installGroup(descriptor, &spec.config);
+
+		if(ret >= 0)
+			installed++;
+
+		logGroup("Group spec %zu installed with result %d", i, ret);
+
+		if(put_user(ret, &batch.specs[i].group_id))
+			return USER_COPY_ERR;
+
+		cond_resched();
+	}
+
+	return installed;
+}
+
+/**
+ * @brief Remove a group from the system
+ * 
+ * The group's sysfs and device file are removed, then the group is removed
+ * from the IDR and from the name table, so that its ID and name can be reused.
+ * 
+ * @param[in] grp_data The group to remove
+ * 
+ * @note Must be called while holding 'main_device_data.sem'
+ * @note The install reference is not dropped
+ */
+static void sRemoveGroup(group_data *grp_data){
+
+	#ifndef DISABLE_SYSFS
+		if(grp_data->flags.sysfs_loaded == 1){
+			logGroup("Releasing sysfs for group %d", grp_data->group_id);
+			releaseSysFs(&grp_data->group_sysfs);
+			grp_data->flags.sysfs_loaded = 0;
+		}
+	#endif
+
+	unregisterGroupDebugfs(grp_data);
+	unregisterGroupDevice(grp_data);
+
+	idr_remove(&main_device_data.group_map, grp_data->group_id);
+	rhashtable_remove_fast(&main_device_data.group_names, &grp_data->name_node, group_names_params);
+}
+
+/**
+ * @brief Uninstall the group corresponding to the provided ID
+ * 
+ * After the group is removed from the system, threads sleeping on its barrier
+ * are woken up and its delayed messages are revoked. The group structure is 
+ * freed only when the last file opened on it is released, after an RCU grace
+ * period.
+ * 
+ * @param[in] group_id The ID of the group to uninstall
+ * 
+ * @retval 0 on success
+ * @retval GROUP_NOT_FOUND if no group is installed with the provided ID
+ * @retval UNAUTHORIZED_ERR if strict mode is enabled and the current user is not the owner
+ */
+int uninstallGroup(const int group_id){
+	group_data *grp_data;
+
+	if(group_id < GRP_MIN_ID || group_id >= GRP_MAX_ID)
+		return GROUP_NOT_FOUND;
+
+	down(&main_device_data.sem);
+
+		grp_data = idr_find(&main_device_data.group_map, group_id);
+
+		if(grp_data == NULL || grp_data->flags.initialized == 0){
+			up(&main_device_data.sem);
+			return GROUP_NOT_FOUND;
+		}
+
+		if(grp_data->flags.strict_mode == 1 && !isOwner(grp_data)){
+			up(&main_device_data.sem);
+			return UNAUTHORIZED_ERR;
+		}
+
+		sRemoveGroup(grp_data);
+
+	up(&main_device_data.sem);
+
+
+	shutdownGroup(grp_data);
+
+	//Drop the install reference, open files keep the group allocated
+	putGroup(grp_data);
+
+	return 0;
+}
+
 /**
  * @brief Return the ID of an existing group from 'group_t' structure
  * 
+ * The lookup is performed on the group name table under RCU, so it never
+ * blocks and runs concurrently with other lookups and installs.
+ * 
  * @note This function respect thread-safety
  * 
  * @param[in] new_group 	Pointer to a 'group_t' strucuture to check
@@ -465,59 +891,49 @@ __must_check int installGroup(const group_t new_group_descriptor){
  */
 __must_check int getGroupID(const group_t new_group){
 	group_data *curr_group;
-	int id_cursor;
+	int group_id = -1;
 
-	if(new_group.group_name == NULL)
+	if(new_group.group_name == NULL || new_group.name_len <= 0)
 		return -1;
 
-	down(&main_device_data.sem);
-		idr_for_each_entry(&main_device_data.group_map, curr_group, id_cursor){
-			
-			pr_debug("Comparing [%s] with [%s]", curr_group->descriptor.group_name, new_group.group_name);
-
-			if(curr_group->descriptor.group_name == NULL)
-				goto cleanup;
-
-			if(strncmp(curr_group->descriptor.group_name, new_group.group_name, DEVICE_NAME_SIZE) == 0){
+	rcu_read_lock();
+		curr_group = rhashtable_lookup(&main_device_data.group_names, &new_group, group_names_params);
 
-				pr_info("Group exists with ID: %d", id_cursor);
+		if(curr_group)
+			group_id = curr_group->group_id;
+	rcu_read_unlock();
 
-				up(&main_device_data.sem);
-				return id_cursor;
-			}
-		}
+	logGroup("Group lookup returned ID: %d", group_id);
 
-	cleanup:
-	up(&main_device_data.sem);
-	return -1;
+	return group_id;
 }
 
 
 /**
- * @brief Get the 'group_t' descriptor from the group ID
+ * @brief Lookup a group from its ID and take a reference on it
  * 
- * @param[in] group_id The group ID
- * @param[out] group_dest A pointer to a 'group_t' strucuture
+ * The IDR is read under RCU, so this function never blocks and does not
+ * serialise with other lookups.
  * 
- * @retval 0 on success
- * @retval -1 on error
+ * @param[in] group_id The group ID
  * 
- * @todo: test if the semaphore is necessary (idr_find)
+ * @retval A pointer to the group, that must be released via 'putGroup'
+ * @retval NULL if the group does not exists or is being released
  */
-__must_check int getGroupInfo(unsigned long group_id, group_t *group_dest){
+group_data *findGroup(const int group_id){
 	group_data *grp_data;
-	
-	down(&main_device_data.sem);
-		grp_data = idr_find(&main_device_data.group_map, group_id);
-	up(&main_device_data.sem);
 
-	if(grp_data == NULL)
-		return -1;
+	if(group_id < GRP_MIN_ID || group_id >= GRP_MAX_ID)
+		return NULL;
 
-	*group_dest = grp_data->descriptor;
+	rcu_read_lock();
+		grp_data = idr_find(&main_device_data.group_map, group_id);
 
-	return 0;
+		if(grp_data && !getGroup(grp_data))
+			grp_data = NULL;
+	rcu_read_unlock();
 
+	return grp_data;
 }
 
 
@@ -18,6 +18,11 @@
 
 #include <linux/ioctl.h>	
 #include <linux/idr.h>
+#include <linux/rhashtable.h>	/* rhashtable_*(), used for the group name index */
+#include <linux/jhash.h>
+#include <linux/sched/signal.h>	/* fatal_signal_pending() */
+#include <linux/proc_fs.h>		/* proc_create_single(), proc_remove() */
+#include <linux/seq_file.h>
 
 
 
@@ -41,6 +46,10 @@
 #define DEV_CREATION_ERR    -12    
 #define CDEV_ALLOC_ERR		-13
 #define GROUP_EXISTS		-14
+#define HASH_INIT_ERR		-15		/**< Returned when the group name hash table cannot be initialized */
+#define GROUP_NOT_FOUND		-16		/**< Returned when no group is installed with the provided ID */
+#define UNAUTHORIZED_ERR	-17		/**< Returned when the current user is not the group's owner */
+#define INVALID_CONFIG_ERR	-18		/**< Returned when a 'group_config_t' contains invalid values */
 
 
 
@@ -50,6 +59,8 @@
 
 #define IOCTL_INSTALL_GROUP _IOW('X', 99, group_t*)
 #define IOCTL_GET_GROUP_ID  _IOW('X', 100, group_t*)
+#define IOCTL_UNINSTALL_GROUP _IOW('X', 101, int)
+#define IOCTL_INSTALL_GROUPS _IOWR('X', 102, group_install_t*)
 
 
 /*------------------------------------------------------------------------------
@@ -65,7 +76,11 @@
 
 
 #define GRP_MIN_ID 		0							/**< Group's min ID */
-#define GRP_MAX_ID		255							/**< Group's max ID */
+#define GRP_MAX_ID		GROUP_MAX_MINORS			/**< Group's max ID (excluded), one minor per group */
+
+#define MAX_GC_RATIO	10							/**< Max garbage collector ratio, see 'garbage_collector_t' */
+
+#define PROC_STATUS_NAME	"thread_synch"			/**< Module-wide status file inside /proc */
 
 /*------------------------------------------------------------------------------
 	Type Definition
@@ -76,7 +91,11 @@
  * 
  * 	This structure is associated with the 'main_thread_synch' device.
  *  Apart from containing the device specification, the field 'group_map'
- * 	employs Linux IDR in order to map group's 'group_data' structure to IDs
+ * 	employs Linux IDR in order to map group's 'group_data' structure to IDs,
+ * 	while 'group_names' indexes the same structures by their descriptor.
+ * 
+ * 	Lookups on both 'group_map' and 'group_names' are RCU-safe and take a
+ * 	reference on the group, so 'sem' only serialises installs and removals
  * 
 */
 typedef struct t_main_sync {
@@ -85,19 +104,44 @@ typedef struct t_main_sync {
 	int minor;								/**< minor# */
 
 	struct idr group_map;					/**< IDR that maps group's ID to their structure*/
+	struct rhashtable group_names;			/**< Hash table that maps group's name to their structure*/
 
-	struct semaphore sem;					/**< Main device IDR semaphore */ 
+	struct semaphore sem;					/**< Serialises updates of the IDR */ 
 
 } main_sync_t;
 
+
+/**
+ * @brief Specification of a group to install with 'IOCTL_INSTALL_GROUPS'
+ * 
+ * On return 'group_id' contains the ID of the installed group or a
+ * negative error code if the installation of this group failed
+ */
+typedef struct group_spec_t {
+	group_t descriptor;				/**< System-wide descriptor of the group */
+	group_config_t config;			/**< Initial configuration of the group */
+	int group_id;					/**< [out] Assigned ID or error code */
+} group_spec_t;
+
+/**
+ * @brief Argument of 'IOCTL_INSTALL_GROUPS'
+ */
+typedef struct group_install_t {
+	group_spec_t *specs;			/**< User-space array of group specifications */
+	size_t count;					/**< Number of elements of 'specs' */
+} group_install_t;
+
 /*------------------------------------------------------------------------------
 	Prototype Declaration
 ------------------------------------------------------------------------------*/
 int mainInit(void);
 void mainExit(void);
 
-void initializeMainDevice(void);
-int installGroup(const group_t new_group);
+int initializeMainDevice(void);
+int installGroup(const group_t new_group, const group_config_t *config);
+int installGroups(group_install_t __user *request);
+int uninstallGroup(const int group_id);
+int getGroupID(const group_t new_group);
 
 static int mainOpen(struct inode *inode, struct file *filep);
 static int mainRelease(struct inode *inode, struct file *filep);
@@ -109,6 +153,8 @@ static long int mainDeviceIoctl(struct file *file, unsigned int ioctl_num, unsig
 
 static int sRegisterMainDev(void);
 static void sUnregisterMainDev(void);
+static void sRemoveGroup(group_data *grp_data);
+static int sGroupsStatusShow(struct seq_file *m, void *v);
 
 
 
@@ -124,6 +170,8 @@ static int main_dev_minor = D_DEV_MINOR;		/**< minor# */
 
 static struct device *main_device;				//Used for "parent" field in device_create; 
 
+static struct proc_dir_entry *status_entry;		/**< Module-wide status file, NULL if not created */
+
 //Main device global pointer 
 static main_sync_t main_device_data;	//TODO use an array to manage multiple main device	
 
@@ -1,4 +1,5 @@
 #include "message.h"
+#include "synch_trace.h"
 
 //Internal Prototypes
 bool isValidSizeLimits(msg_t *msg, msg_manager_t *manager);
@@ -12,18 +13,47 @@ bool isValidSizeLimits(msg_t *msg, msg_manager_t *manager);
  */
 void debugMsg(msg_t msg){
 
-    pr_debug("MESSAGE DATA");
-    pr_debug("Message type size %ld", msg.size);
-    pr_debug("Message author pid %d", msg.author);
+    logMessage("MESSAGE DATA");
+    logMessage("Message type size %ld", msg.size);
+    logMessage("Message author pid %d", msg.author);
 
     if(msg.size == sizeof(char) && msg.buffer != NULL){
-        pr_debug("Message string %s", (char*)msg.buffer);
+        logMessage("Message string %s", (char*)msg.buffer);
     }
 
 }
 
 
 #ifndef DISABLE_DELAYED_MSG
+
+static struct workqueue_struct *delayed_wq;     /**< Workqueue where delayed messages are delivered*/
+
+
+/**
+ * @brief Allocate the workqueue used to deliver delayed messages
+ * 
+ * @retval 0 on success
+ * @retval ALLOC_ERR if the workqueue cannot be allocated
+ */
+int initDelayedQueue(void){
+    delayed_wq = alloc_workqueue("synch_delayed", WQ_UNBOUND, 0);
+
+    if(!delayed_wq)
+        return ALLOC_ERR;
+
+    return 0;
+}
+
+/**
+ * @brief Wait for all the delayed deliveries and release the workqueue
+ * 
+ * @return nothing
+ */
+void releaseDelayedQueue(void){
+    destroy_workqueue(delayed_wq);
+}
+
+
 /**
  * @brief Check if the message delay is greater than zero on a group
  * 
@@ -42,58 +72,55 @@ bool isDelaySet(const msg_manager_t *manager){
 }
 
 /**
- * @brief Called when a timer for a delayed message expires
+ * @brief Called when the delay of a message expires
  * 
  * The function simply take the existing 't_message_delayed_deliver' structure,
  * extract the 'msg_t' field and write it into the FIFO queue via the 'writeMessage'
- * function.
+ * function. 
+ * 
+ * @note The function runs in process context on 'delayed_wq', so it is
+ *      allowed to sleep while writing the message
  * 
- * @param[in] timer The timer that elasped
+ * @param[in] work The work of the elapsed message
  * @return nothing
  */
-void delayedMessageCallback(struct timer_list *timer){
+void delayedMessageCallback(struct work_struct *work){
 
     struct t_message_delayed_deliver *delayed_msg;  //Elasped msg
-    msg_t *msg_deliver;     //Message to add to the queue
+    msg_manager_t *manager;
+    group_data *grp_data;
+    u64 held;
     int ret;                           
 
-    pr_info("delayedMessageCallback: timer elasped");
-
-
-    delayed_msg = from_timer(delayed_msg, timer, delayed_timer);
-    msg_deliver = &delayed_msg->message;
-
-
-    if(delayed_msg->manager == NULL){
-        pr_err("Message manager is not allocated, exiting");
-        return;
-    }
+    logDelay("delayedMessageCallback: delay elapsed");
 
-    pr_info("delayedMessageCallback: Writing message into the FIFO queue");
 
-    if((ret = writeMessage(msg_deliver, delayed_msg->manager)) < 0){
-        pr_err("delayedMessageCallback: Unable to deliver delayed message: %d", ret);
-        return;
-    }
+    delayed_msg = container_of(to_delayed_work(work), struct t_message_delayed_deliver, delayed_work);
+    manager = delayed_msg->manager;
+    grp_data = manager->group;
 
 
-    pr_debug("delayedMessage: trying to acquire lock");
-    down(&delayed_msg->manager->delayed_lock);
-        pr_debug("delayedMessage: lock acquired");
+    //Unlink the entry first, in this way revoke and cancel will skip it
+    held = statsDown(grp_data, LOCK_DELAYED, &manager->delayed_lock);
         list_del(&delayed_msg->delayed_list);
-        kfree(delayed_msg);
-    up(&delayed_msg->manager->delayed_lock);
-    pr_info("delayedMessageCallback: unlocking delayed list after deleting entries");
+        manager->delayed_depth--;
+    statsUp(grp_data, LOCK_DELAYED, &manager->delayed_lock, held);
 
+    logDelay("delayedMessageCallback: Writing message into the FIFO queue");
 
+    ret = writeMessage(&delayed_msg->message, manager, delayed_msg->sender);
+    trace_synch_delayed_release(grp_data->group_id, delayed_msg->message.size, delayed_msg->message.author, ret);
+    statsLatency(grp_data->stats.release_latency, delayed_msg->timestamp);
 
-    //Deallocate structures
-    if(!del_timer(timer))
-        pr_err("Strange behaviour: timer callback called but timer not elasped...");
-    
+    if(ret < 0){
+        pr_err("delayedMessageCallback: Unable to deliver delayed message: %d", ret);
+        kfree(delayed_msg->message.buffer);
+    }
 
+    kfree(delayed_msg);
 
-    return;
+    //Drop the reference taken by 'queueDelayedMessage'
+    putGroup(grp_data);
 }
 
 /**
@@ -101,24 +128,30 @@ void delayedMessageCallback(struct timer_list *timer){
  * 
  * @param[in] message The message to insert into the queue
  * @param[in] manager A pointer to the current msg_manager_t of the group
+ * @param[in] sender  Member key of the author, see 'writeMessage'
  * 
+ * @note The queued message holds a reference on the group until it is
+ *      delivered or revoked, so the group cannot be freed in the meanwhile
  * 
  * @retval 0 on success
  * @retval -1 on error
  */
-int queueDelayedMessage(msg_t *message, msg_manager_t *manager){
+int queueDelayedMessage(msg_t *message, msg_manager_t *manager, const pid_t sender){
     struct t_message_delayed_deliver *newMessageDeliver;
     long delay;
+    u64 held;
 
     if(!message || !manager){
         pr_err("%s: NULL pointers", __FUNCTION__);
         return -1;
     }
 
-    pr_debug("queueDelayedMessage: Checking size limits...");
+    logDelay("queueDelayedMessage: Checking size limits...");
 
     if(!isValidSizeLimits(message, manager)){
-        pr_debug("Message size is invalid");
+        logDelay("Message size is invalid");
+        trace_synch_msg_write_reject(manager->group->group_id, message->size, message->author, STORAGE_SIZE_ERR);
+        statsAdd(manager->group, rejected, message->size);
         return -1;
     }
 
@@ -126,26 +159,35 @@ int queueDelayedMessage(msg_t *message, msg_manager_t *manager){
     if(!newMessageDeliver)
         return -1;
 
+    if(!getGroup(manager->group)){
+        kfree(newMessageDeliver);
+        return -1;
+    }
+
     newMessageDeliver->message = *message;
+    newMessageDeliver->sender = sender;
     newMessageDeliver->manager = manager;
+    newMessageDeliver->timestamp = ktime_get();
 
 
     delay = atomic_long_read(&manager->message_delay);
 
-    pr_debug("queueDelayedMessage: Delay value %ld", delay);
+    logDelay("queueDelayedMessage: Delay value %ld", delay);
 
-    timer_setup(&newMessageDeliver->delayed_timer, delayedMessageCallback, 0);
+    INIT_DELAYED_WORK(&newMessageDeliver->delayed_work, delayedMessageCallback);
 
-    //Add to the msg_manager message queue
-    down(&manager->delayed_lock);
+    //Add to the msg_manager message queue and start the delay
+    held = statsDown(manager->group, LOCK_DELAYED, &manager->delayed_lock);
         //Queue Critical Section
-        list_add_rcu(&newMessageDeliver->delayed_list, &manager->delayed_queue);
-    up(&manager->delayed_lock);
+        list_add_tail(&newMessageDeliver->delayed_list, &manager->delayed_queue);
+        manager->delayed_depth++;
+        queue_delayed_work(delayed_wq, &newMessageDeliver->delayed_work, delay * HZ);
+    statsUp(manager->group, LOCK_DELAYED, &manager->delayed_lock, held);
+
+    trace_synch_delayed_queue(manager->group->group_id, message->size, message->author, delay);
+    statsAdd(manager->group, delayed, message->size);
 
-    //Set delay and start the timer
-    newMessageDeliver->delayed_timer.expires = jiffies + delay * HZ;
-    add_timer(&newMessageDeliver->delayed_timer);
-    pr_debug("queueDelayedMessage: Timer started");
+    logDelay("queueDelayedMessage: Delay started");
 
     return 0;    
 }
@@ -157,36 +199,45 @@ int queueDelayedMessage(msg_t *message, msg_manager_t *manager){
  * 
  * @note This function is thread safe with respect to the list of 
  *          delayed message
+ * @note Messages whose delay already elapsed are being delivered and are
+ *          not revoked
  * 
  * @return The number of delayed messages which revoked 
  */
 int revokeDelayedMessage(msg_manager_t *manager){
-    struct list_head *cursor, *temp;
-    struct t_message_delayed_deliver *msgDeliver;
+    struct t_message_delayed_deliver *msgDeliver, *temp;
+    group_data *grp_data = manager->group;
+    LIST_HEAD(revoked);
     int count = 0;
+    u64 held;
 
-    pr_debug("Revoking delayed messages...");
+    logDelay("Revoking delayed messages...");
 
-    down(&manager->delayed_lock);
+    held = statsDown(grp_data, LOCK_DELAYED, &manager->delayed_lock);
 
-        list_for_each_safe(cursor, temp, &manager->delayed_queue){
+        list_for_each_entry_safe(msgDeliver, temp, &manager->delayed_queue, delayed_list){
 
-            msgDeliver = list_entry(cursor, struct t_message_delayed_deliver, delayed_list);
-            
-            if(msgDeliver != NULL){
-                //Stop the timer
-                //TODO: check thread safety with the callback function
-                pr_debug("Message timer deleted");
-                del_timer(&msgDeliver->delayed_timer);
-            }
+            //If the work is already running the message is being delivered
+            if(!cancel_delayed_work(&msgDeliver->delayed_work))
+                continue;
 
-            list_del_init(cursor);
+            list_move(&msgDeliver->delayed_list, &revoked);
+            manager->delayed_depth--;
             count++;
         }
 
-        synchronize_rcu();
+    statsUp(grp_data, LOCK_DELAYED, &manager->delayed_lock, held);
+
 
-    up(&manager->delayed_lock);
+    list_for_each_entry_safe(msgDeliver, temp, &revoked, delayed_list){
+        list_del(&msgDeliver->delayed_list);
+        statsAdd(grp_data, revoked, msgDeliver->message.size);
+
+        kfree(msgDeliver->message.buffer);
+        kfree(msgDeliver);
+
+        putGroup(grp_data);
+    }
 
     return count;
 }
@@ -199,36 +250,32 @@ int revokeDelayedMessage(msg_manager_t *manager){
  * 
  * @return The number of messages which delay was cancelled
  * 
- * @note At the moment the function locks the delayed queue, set all timers to zero and 
- *      unlock the queue. This means that while the function loops through the queue,
- *      timer's callback will wait since the queue is locked.
+ * @note At the moment the function locks the delayed queue, requeue all the pending
+ *      works without delay and unlock the queue. This means that while the function
+ *      loops through the queue, elapsed works will wait since the queue is locked.
  */
 int cancelDelay(msg_manager_t *manager){
-    struct list_head *cursor, *temp;
     struct t_message_delayed_deliver *msgDeliver;
     int count = 0;
+    u64 held;
 
-    pr_debug("cancelDelay: Cancelling delay on messages...");
+    logDelay("cancelDelay: Cancelling delay on messages...");
 
-    down(&manager->delayed_lock);
+    held = statsDown(manager->group, LOCK_DELAYED, &manager->delayed_lock);
 
-        list_for_each_safe(cursor, temp, &manager->delayed_queue){
+        list_for_each_entry(msgDeliver, &manager->delayed_queue, delayed_list){
 
-            msgDeliver = list_entry(cursor, struct t_message_delayed_deliver, delayed_list);
-            
-            if(msgDeliver != NULL){
-                //Stop the timer
-                //TODO: See notes. Possibly substitute with del_timer_synch
-                pr_debug("cancelDelay: timer stopped");
+            //Works that are already running are not queued twice
+            if(cancel_delayed_work(&msgDeliver->delayed_work)){
+                logDelay("cancelDelay: delay removed");
 
-                mod_timer(&msgDeliver->delayed_timer, 0);
-                //del_timer_synch(&msgDeliver->delayed_timer);
+                queue_delayed_work(delayed_wq, &msgDeliver->delayed_work, 0);
                 count++;
             }
         }
 
-    up(&manager->delayed_lock);
-    pr_debug("cancelDelay: delayed queue unlocked");
+    statsUp(manager->group, LOCK_DELAYED, &manager->delayed_lock, held);
+    logDelay("cancelDelay: delayed queue unlocked");
 
     return count;
 }
@@ -248,12 +295,13 @@ int cancelDelay(msg_manager_t *manager){
 bool isStructSizeIncluded(msg_manager_t *manager){
     group_data *grp_data;
 
-    grp_data = container_of(&manager, group_data, msg_manager);
+    //The manager is allocated separately, so 'container_of' cannot be used
+    grp_data = manager->group;
 
     if(!grp_data)
         return false;
 
-    pr_debug("Include struct flag value: %d", grp_data->flags.gc_include_struct);
+    logMessage("Include struct flag value: %d", grp_data->flags.gc_include_struct);
 
     if(grp_data->flags.gc_include_struct == 1)
         return true;
@@ -302,7 +350,7 @@ bool isValidSizeLimits(msg_t *msg, msg_manager_t *manager){
         else
             structure_size = 0;
         
-        pr_debug("Total new size: %lu", curr_storage_size + msg_size + structure_size);
+        logMessage("Total new size: %lu", curr_storage_size + msg_size + structure_size);
 
         if(curr_storage_size + msg_size + structure_size > max_storage_size)
             return false;
@@ -326,7 +374,7 @@ void copy_current_participants(struct list_head *dest, struct list_head *source)
 
         src_elem = list_entry(cursor, group_members_t, list);
 
-        pr_debug("Message participant: %d", src_elem->pid);
+        logMessage("Message participant: %d", src_elem->pid);
 
         if(!src_elem)
             return;
@@ -344,7 +392,7 @@ void copy_current_participants(struct list_head *dest, struct list_head *source)
     }
 
 
-    pr_debug("Copied %d participants as message recipient", count);
+    logMessage("Copied %d participants as message recipient", count);
 
 }
 
@@ -409,6 +457,7 @@ int deallocate_recipients(struct t_message_deliver *msg_deliver){
             return -1;
 
         list_del_init(cursor);
+        kfree(elem);
         count++;
     }
 
@@ -435,6 +484,7 @@ int deallocate_recipients_safe(struct t_message_deliver *msg_deliver){
                 return -1;
 
             list_del_init(cursor);
+            kfree(elem);
             count++;
         }
     up_write(&msg_deliver->recipient_lock);
@@ -546,22 +596,22 @@ bool isDeliveryCompleted(const struct list_head *recipients, const struct list_h
 __must_check int copy_msg_to_user(const msg_t *kmsg, __user char *ubuffer, const ssize_t _size){
 
     if(kmsg == NULL){
-        pr_debug("copy_msg_to_user: kernel message NULL pointer provided");
+        logMessage("copy_msg_to_user: kernel message NULL pointer provided");
         return -EFAULT;
     }
 
     if(ubuffer == NULL){
-        pr_debug("copy_msg_to_user: user buffer NULL pointer provided");
+        logMessage("copy_msg_to_user: user buffer NULL pointer provided");
         return -EFAULT;
     }
 
     if(!access_ok(ubuffer, _size)){
-        pr_debug("copy_msg_to_user: user-space memory access is invalid");
+        logMessage("copy_msg_to_user: user-space memory access is invalid");
         return -EFAULT;
     }
 
     if(copy_to_user(ubuffer, kmsg->buffer, _size)){
-        pr_debug("copy_msg_to_user: Unable to copy msg_t structure to user");
+        logMessage("copy_msg_to_user: Unable to copy msg_t structure to user");
         return -EFAULT;
     }
 
@@ -589,7 +639,7 @@ __must_check int copy_msg_from_user(msg_t *kmsg, const char *umsg, const ssize_t
 
 
     if(!access_ok(umsg, _size)){
-        pr_debug("copy_msg_from_user: user-space memory access is invalid");
+        logMessage("copy_msg_from_user: user-space memory access is invalid");
         return -EFAULT;        
     }
 
@@ -614,34 +664,38 @@ __must_check int copy_msg_from_user(msg_t *kmsg, const char *umsg, const ssize_t
 
 /**
  * @brief Allocate and initialize all the members of a 'msg_manager_t' struct
- * @param[in] _max_message_size    Configurable param
- * @param[in] _max_storage_size    Configurable param
- * @param[in] garbageCollectorFunction Pointer to the work_struct responsible for garbage collection 
+ * @param[in] config              Initial sizes, garbage collector ratio and delay
+ * @param[in] garbage_collector   Pointer to the group's garbage collector
  * 
  * @retval An 'msg_manager_t' pointer to an allocated an initialized 'msg_manager_t' struct
  * @retval A NULL pointer in case the 'kmalloc' fails
  */
-__must_check msg_manager_t *createMessageManager(const u_int _max_storage_size, const u_int _max_message_size, garbage_collector_t *garbage_collector){
+__must_check msg_manager_t *createMessageManager(const group_config_t *config, garbage_collector_t *garbage_collector){
 
     msg_manager_t *manager = (msg_manager_t*)kmalloc(sizeof(msg_manager_t), GFP_KERNEL);
     if(!manager)
         return NULL;
 
-    manager->max_storage_size = _max_storage_size;
-    manager->max_message_size = _max_message_size;
+    manager->max_storage_size = config->max_storage_size;
+    manager->max_message_size = config->max_message_size;
     manager->curr_storage_size = 0;
+    manager->queue_depth = 0;
+    manager->group = NULL;
+    atomic64_set(&manager->sequence, 0);
 
     INIT_LIST_HEAD(&manager->queue);
 
     init_rwsem(&manager->queue_lock);
     init_rwsem(&manager->config_lock);
+    init_waitqueue_head(&manager->read_wait);
 
     INIT_WORK(&garbage_collector->work, queueGarbageCollector);
-    atomic_set(&garbage_collector->ratio, DEFAULT_GC_RATIO);
+    atomic_set(&garbage_collector->ratio, config->garbage_collector_ratio);
 
     #ifndef DISABLE_DELAYED_MSG
         sema_init( &manager->delayed_lock, 1);
-        atomic_long_set(&manager->message_delay, 0);
+        atomic_long_set(&manager->message_delay, config->message_delay);
+        manager->delayed_depth = 0;
         INIT_LIST_HEAD(&manager->delayed_queue);
     #endif
 
@@ -649,11 +703,38 @@ __must_check msg_manager_t *createMessageManager(const u_int _max_storage_size,
 }
 
 
+/**
+ * @brief Deallocate a 'msg_manager_t' struct and all the messages in its queue
+ * @param[in] manager The message manager to free
+ * 
+ * @note Must be called only when the group is no longer reachable, after all
+ *      the delayed messages are delivered or revoked and the garbage collector
+ *      is stopped
+ * 
+ * @return nothing
+ */
+void destroyMessageManager(msg_manager_t *manager){
+    struct t_message_deliver *entry, *temp;
+
+    list_for_each_entry_safe(entry, temp, &manager->queue, fifo_list){
+        deallocate_recipients(entry);
+        list_del(&entry->fifo_list);
+
+        kfree(entry->message.buffer);
+        kfree(entry);
+    }
+
+    kfree(manager);
+}
+
+
 /**
  * @brief write message on a group queue
  * @param[in] message   The data pointed must never be deallocatated
  * @param[in] manager   Pointer to the message manager
- * @param[in] recipients    The head of the linked list containing the thread recipients
+ * @param[in] sender    Member key of the author (see 'fileMember'), excluded from
+ *                      the recipients. It differs from 'message->author' for
+ *                      messages written through a shared handle
  * 
  * @retval 0 on success
  * @retval STORAGE_SIZE_ERR if the message does not respect the group's size limits
@@ -663,24 +744,30 @@ __must_check msg_manager_t *createMessageManager(const u_int _max_storage_size,
  *          recipient data-structure and manager's message queue
  * 
  */
-int writeMessage(msg_t *message, msg_manager_t *manager){
+int writeMessage(msg_t *message, msg_manager_t *manager, const pid_t sender){
 
     struct t_message_deliver *newMessageDeliver;
-    group_members_t *sender;
+    group_members_t *member;
     int ret = 0;
     u_long message_size;
+    u64 held;
 
     if(!isValidSizeLimits(message, manager)){
-        pr_debug("Message size is invalid");
+        logMessage("Message size is invalid");
+        trace_synch_msg_write_reject(manager->group->group_id, message->size, message->author, STORAGE_SIZE_ERR);
+        statsAdd(manager->group, rejected, message->size);
         return STORAGE_SIZE_ERR;
     }
 
     newMessageDeliver = (struct t_message_deliver*)kmalloc(sizeof(struct t_message_deliver), GFP_KERNEL);
-    if(!newMessageDeliver)
+    if(!newMessageDeliver){
+        trace_synch_msg_write_reject(manager->group->group_id, message->size, message->author, ALLOC_ERR);
         return ALLOC_ERR;   //No need to cleanup
+    }
 
 
     newMessageDeliver->message = *message;
+    newMessageDeliver->sender = sender;
 
     init_rwsem(&newMessageDeliver->recipient_lock);
 
@@ -688,24 +775,36 @@ int writeMessage(msg_t *message, msg_manager_t *manager){
     INIT_LIST_HEAD(&newMessageDeliver->recipient);
 
     //Add the sender to the list of recipients
-    sender = (group_members_t*)kmalloc(sizeof(group_members_t), GFP_KERNEL);
+    member = (group_members_t*)kmalloc(sizeof(group_members_t), GFP_KERNEL);
     
-    if(!sender){
+    if(!member){
         ret = ALLOC_ERR;
         goto cleanup;
     }
 
-    //Add the sender's PID in order to avoid reading its own messages
-    sender->pid = current->pid;
-    list_add_tail(&sender->list, &newMessageDeliver->recipient);
+    //Add the sender's key in order to avoid reading its own messages
+    //  (delayed messages are written by a worker, so 'current' is not the sender)
+    member->pid = sender;
+    list_add_tail(&member->list, &newMessageDeliver->recipient);
 
 
     //Add to the msg_manager message queue
-    down_write(&manager->queue_lock);
-        //Queue Critical Section
+    held = statsDownWrite(manager->group, LOCK_QUEUE, &manager->queue_lock);
+        //Queue Critical Section, the sequence follows the order of the queue
+        newMessageDeliver->sequence = atomic64_inc_return(&manager->sequence);
+        newMessageDeliver->timestamp = ktime_get();
         list_add_tail(&newMessageDeliver->fifo_list, &manager->queue);
-    up_write(&manager->queue_lock);
-    pr_debug("writeMessage: queue_lock released");
+        manager->queue_depth++;
+        statsPeak(&manager->group->stats.peak_queue_depth, manager->queue_depth);
+    statsUpWrite(manager->group, LOCK_QUEUE, &manager->queue_lock, held);
+
+    //The barrier of 'wq_has_sleeper' pairs with the one of 'poll_wait'
+    if(wq_has_sleeper(&manager->read_wait))
+        wake_up_interruptible_poll(&manager->read_wait, EPOLLIN | EPOLLRDNORM);
+
+    trace_synch_msg_write_accept(manager->group->group_id, message->size, message->author, newMessageDeliver->sequence);
+    statsAdd(manager->group, written, message->size);
+    logMessage("writeMessage: queue_lock released");
 
 
     //Update storage parameters
@@ -715,37 +814,85 @@ int writeMessage(msg_t *message, msg_manager_t *manager){
     if(isStructSizeIncluded(manager))
         message_size += sizeof(struct t_message_deliver);
 
-    pr_debug("Message Size: %lu", message_size);
+    logMessage("Message Size: %lu", message_size);
 
-    down_write(&manager->config_lock);
+    held = statsDownWrite(manager->group, LOCK_CONFIG, &manager->config_lock);
         manager->curr_storage_size += message_size;
-    up_write(&manager->config_lock);
+        statsPeak(&manager->group->stats.peak_storage_size, manager->curr_storage_size);
+    statsUpWrite(manager->group, LOCK_CONFIG, &manager->config_lock, held);
 
 
     return ret; 
 
 
     cleanup:
+        trace_synch_msg_write_reject(manager->group->group_id, message->size, message->author, ret);
         kfree(newMessageDeliver);
         return ret;
 }
 
+/**
+ * @brief Check under the read lock if a message was delivered to a reader
+ */
+static bool sWasDelivered(msg_manager_t *manager, struct t_message_deliver *msg_deliver, const pid_t reader){
+    bool delivered;
+    u64 held;
+
+    held = statsDownRead(manager->group, LOCK_RECIPIENT, &msg_deliver->recipient_lock);
+        delivered = wasDelivered(&msg_deliver->recipient, reader);
+    statsUpRead(manager->group, LOCK_RECIPIENT, &msg_deliver->recipient_lock, held);
+
+    return delivered;
+}
+
+/**
+ * @brief Mark a message as delivered to a reader, unless it already was
+ * 
+ * The check and the update are a single step under the recipient lock, so
+ * threads reading with the same member key (see 'IOCTL_SHARE_HANDLE') 
+ * cannot both receive the message. The caller skips messages already
+ * delivered through 'sWasDelivered', under the read lock.
+ * 
+ * @retval true if the caller must deliver the message
+ */
+static bool sClaimMessage(msg_manager_t *manager, struct t_message_deliver *msg_deliver, const pid_t reader){
+    bool claimed = false;
+    u64 held;
+
+    held = statsDownWrite(manager->group, LOCK_RECIPIENT, &msg_deliver->recipient_lock);
+        if(!wasDelivered(&msg_deliver->recipient, reader)){
+            setDelivered(&msg_deliver->recipient, reader);
+            claimed = true;
+        }
+    statsUpWrite(manager->group, LOCK_RECIPIENT, &msg_deliver->recipient_lock, held);
+
+    return claimed;
+}
+
 /**
  * @brief Read a message from the corresponding queue
+ * @param[out] dest_buffer  Where the message is copied
+ * @param[in] manager       The message manager of the group
+ * @param[in] reader        Member key of the reader, see 'fileMember'
+ * @param[in] max_size      Size of the reader's buffer
+ * 
  * @retval 0 on success
  * @retval 1 if no message is present
+ * @retval -EMSGSIZE if the next message is longer than 'max_size', it is left 
+ *          in the queue
  * @retval -1 on critical error
  */
 
-int readMessage(msg_t *dest_buffer, msg_manager_t *manager){
+int readMessage(msg_t *dest_buffer, msg_manager_t *manager, const pid_t reader, const size_t max_size){
 
     struct list_head *cursor;
     struct t_message_deliver *msg_deliver;
-    pid_t pid = current->pid;
+    pid_t pid = reader;
+    u64 queue_held, held;
 
 
-    down_read(&manager->queue_lock);
-    pr_debug("readMessage: queue_lock acquired");
+    queue_held = statsDownRead(manager->group, LOCK_QUEUE, &manager->queue_lock);
+    logMessage("readMessage: queue_lock acquired");
 
         //Read queue critical section
         list_for_each(cursor, &manager->queue){
@@ -756,7 +903,7 @@ int readMessage(msg_t *dest_buffer, msg_manager_t *manager){
             if(!msg_deliver)
                 goto cleanup;
 
-            if(msg_deliver->message.author == pid){
+            if(msg_deliver->sender == pid){
                 /**
                  * This should't be necessary since the message's sender is
                  * automatically added in the list of recipients and, consequently,
@@ -767,29 +914,33 @@ int readMessage(msg_t *dest_buffer, msg_manager_t *manager){
                  * @bug: when 'revoke delay' functionality is called, messages trigger
                  *  this if and will not be delivered
                  */
-                pr_debug("Message sent from the reader, skipping...");
-                pr_debug("Sender PID: %d", pid);
-                pr_debug("Message Content %s", (char*)msg_deliver->message.buffer);
-            }else if(!wasDelivered(&msg_deliver->recipient, pid)){
-                pr_debug("Message found for PID: %d", (int)pid);
+                logMessage("Message sent from the reader, skipping...");
+                logMessage("Sender PID: %d", pid);
+                logMessage("Message Content %s", (char*)msg_deliver->message.buffer);
+            }else if(sWasDelivered(manager, msg_deliver, pid)){
+                //Already read, continue with the next message
+            }else if(msg_deliver->message.size > max_size){
+                statsUpRead(manager->group, LOCK_QUEUE, &manager->queue_lock, queue_held);
+                logMessage("Message of %zu bytes does not fit a buffer of %zu", msg_deliver->message.size, max_size);
+                return -EMSGSIZE;
+            }else if(sClaimMessage(manager, msg_deliver, pid)){
+                logMessage("Message found for PID: %d", (int)pid);
                 //Copy the message to the destination buffer
                 memcpy(dest_buffer, &msg_deliver->message, sizeof(msg_t));
+                trace_synch_msg_read_deliver(manager->group->group_id, msg_deliver->message.size, pid, msg_deliver->sequence);
+                statsAdd(manager->group, read, msg_deliver->message.size);
+                statsLatency(manager->group->stats.delivery_latency, msg_deliver->timestamp);
 
-                down_write(&msg_deliver->recipient_lock);
-                    //Procedure to remove the current recipient from the recipient's list
-                    setDelivered(&msg_deliver->recipient, pid);
-                up_write(&msg_deliver->recipient_lock);
-
-                
-                up_read(&manager->queue_lock);
-                pr_debug("readMessage: queue_lock released");
+                statsUpRead(manager->group, LOCK_QUEUE, &manager->queue_lock, queue_held);
+                logMessage("readMessage: queue_lock released");
 
 
                 //Update the current storage size with the recipient's entry in the list
                 if(isStructSizeIncluded(manager)){
-                    down_write(&manager->config_lock);
+                    held = statsDownWrite(manager->group, LOCK_CONFIG, &manager->config_lock);
                         manager->curr_storage_size += sizeof(group_members_t);
-                    up_write(&manager->config_lock);
+                        statsPeak(&manager->group->stats.peak_storage_size, manager->curr_storage_size);
+                    statsUpWrite(manager->group, LOCK_CONFIG, &manager->config_lock, held);
                 }
 
 
@@ -799,15 +950,16 @@ int readMessage(msg_t *dest_buffer, msg_manager_t *manager){
             //Otherwise, continue with the next message
         }
 
-    up_read(&manager->queue_lock);
-    pr_debug("readMessage: queue_lock released");
+    statsUpRead(manager->group, LOCK_QUEUE, &manager->queue_lock, queue_held);
+    logMessage("readMessage: queue_lock released");
 
-    pr_debug("No message present for PID: %d", pid);
+    logMessage("No message present for PID: %d", pid);
+    trace_synch_msg_read_miss(manager->group->group_id, pid, atomic64_read(&manager->sequence));
     return 1;
 
 
     cleanup:
-        up_read(&manager->queue_lock);
+        statsUpRead(manager->group, LOCK_QUEUE, &manager->queue_lock, queue_held);
         pr_err("readMessage: 'list_entry' returned a NULL pointer");
         return -1;
 }
@@ -817,6 +969,54 @@ int readMessage(msg_t *dest_buffer, msg_manager_t *manager){
 
 
 
+/**
+ * @brief Find the message that 'readMessage' would deliver to a reader, without delivering it
+ * @param[in] manager   The message manager of the group
+ * @param[in] reader    Member key of the reader, see 'fileMember'
+ * @param[out] size     Size of the message, may be NULL
+ * 
+ * @note The queue is scanned up to the first message not yet delivered to the
+ *      reader, which is normally at the head of the queue
+ * 
+ * @retval 0 if a message is available
+ * @retval 1 if no message is available
+ */
+int peekMessage(msg_manager_t *manager, const pid_t reader, size_t *size){
+    struct t_message_deliver *msg_deliver;
+    bool found = false;
+    u64 queue_held;
+
+    queue_held = statsDownRead(manager->group, LOCK_QUEUE, &manager->queue_lock);
+
+        list_for_each_entry(msg_deliver, &manager->queue, fifo_list){
+
+            if(msg_deliver->sender == reader)
+                continue;
+
+            found = !sWasDelivered(manager, msg_deliver, reader);
+
+            if(found){
+                if(size)
+                    *size = msg_deliver->message.size;
+                break;
+            }
+        }
+
+    statsUpRead(manager->group, LOCK_QUEUE, &manager->queue_lock, queue_held);
+
+    return found ? 0 : 1;
+}
+
+/**
+ * @brief Check if a message is available for a reader, without delivering it
+ * 
+ * @retval true if 'readMessage' would deliver a message
+ */
+bool hasMessage(msg_manager_t *manager, const pid_t reader){
+    return peekMessage(manager, reader, NULL) == 0;
+}
+
+
 /**
  * @brief Remove a message from the queue when it was completely delivered
  * @param[in] work The work struct contained inside "msg_manager_t"
@@ -846,6 +1046,7 @@ void queueGarbageCollector(struct work_struct *work){
     u_long total_msg_size;
     u_long total_deleted_size;
 
+    u64 member_held, queue_held, held;
 
 
 
@@ -858,7 +1059,8 @@ void queueGarbageCollector(struct work_struct *work){
         return;
 
 
-    pr_debug("Garbage Collector starting...");
+    logGc("Garbage Collector starting...");
+    trace_synch_gc_start(grp_data->group_id, grp_data->msg_manager->curr_storage_size);
 
     deleted_entries = 0;
     deleted_recipients = 0;
@@ -867,26 +1069,28 @@ void queueGarbageCollector(struct work_struct *work){
     total_recipients_size = 0;
     total_deleted_size = 0;
 
-    down_read(&grp_data->member_lock);
+    member_held = statsDownRead(grp_data, LOCK_MEMBER, &grp_data->member_lock);
 
         current_member = &grp_data->active_members;
 
         if(!down_write_trylock(&grp_data->msg_manager->queue_lock)){
-            pr_debug("Garbage Collector: Unable to acquire queue lock, skipping...");
-            up_read(&grp_data->member_lock);
+            logGc("Garbage Collector: Unable to acquire queue lock, skipping...");
+            statsUpRead(grp_data, LOCK_MEMBER, &grp_data->member_lock, member_held);
+            trace_synch_gc_end(grp_data->group_id, 0, 0, 0, true);
             return;
         }
+        queue_held = statsLockTaken(grp_data, LOCK_QUEUE);
         //Queue Critical Section
 
             list_for_each_safe(cursor, temp, &grp_data->msg_manager->queue){
 
                 struct t_message_deliver *entry = list_entry(cursor, struct t_message_deliver, fifo_list);
 
-                down_read(&entry->recipient_lock);
+                held = statsDownRead(grp_data, LOCK_RECIPIENT, &entry->recipient_lock);
                 //Recipient critical section
 
                     if(isDeliveryCompleted(&entry->recipient, current_member)){
-                        pr_debug("Garbage Collector: deleting entry from queue");
+                        logGc("Garbage Collector: deleting entry from queue");
 
                         kfree(entry->message.buffer);  //Message Buffer
                         total_msg_size += entry->message.size;
@@ -896,17 +1100,23 @@ void queueGarbageCollector(struct work_struct *work){
                         
                         list_del_init(cursor);  //TODO: check if the recipients list is deallocated
 
+                        //The lock lives in the entry, release it before freeing
+                        statsUpRead(grp_data, LOCK_RECIPIENT, &entry->recipient_lock, held);
                         kfree(entry);   //t_message_deliver 
 
                         deleted_entries++;
+                    }else{
+                        statsUpRead(grp_data, LOCK_RECIPIENT, &entry->recipient_lock, held);
                     }
-
-                up_read(&entry->recipient_lock);                
             }
 
-        up_write(&grp_data->msg_manager->queue_lock);
+            grp_data->msg_manager->queue_depth -= deleted_entries;
 
-    up_read(&grp_data->member_lock);
+        statsUpWrite(grp_data, LOCK_QUEUE, &grp_data->msg_manager->queue_lock, queue_held);
+
+    statsUpRead(grp_data, LOCK_MEMBER, &grp_data->member_lock, member_held);
+
+    statsAddN(grp_data, reclaimed, deleted_entries, total_msg_size);
 
 
     //Update storage parameters
@@ -918,11 +1128,13 @@ void queueGarbageCollector(struct work_struct *work){
 
     total_deleted_size = total_msg_size + deleted_deliver_size + total_recipients_size;
 
-    down_write(&manager->config_lock);
+    held = statsDownWrite(grp_data, LOCK_CONFIG, &manager->config_lock);
         if(total_deleted_size > manager->curr_storage_size)
             manager->curr_storage_size = 0;
         else
             manager->curr_storage_size -= total_deleted_size;
-    up_write(&manager->config_lock);
+    statsUpWrite(grp_data, LOCK_CONFIG, &manager->config_lock, held);
+
+    trace_synch_gc_end(grp_data->group_id, deleted_entries, deleted_recipients, total_deleted_size, false);
 
 }
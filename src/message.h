@@ -17,9 +17,13 @@
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
 #include <linux/atomic.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
 
 
 #include "types.h"
+#include "stats.h"
+#include "log.h"
 
 
 #define NO_MSG_PRESENT          0
@@ -48,10 +52,13 @@
 
 
 
-msg_manager_t *createMessageManager(const u_int _max_storage_size, const u_int _max_message_size, garbage_collector_t *garbageCollector);
+msg_manager_t *createMessageManager(const group_config_t *config, garbage_collector_t *garbageCollector);
+void destroyMessageManager(msg_manager_t *manager);
 
-int writeMessage(msg_t *message, msg_manager_t *manager);
-int readMessage(msg_t *dest_buffer, msg_manager_t *manager);
+int writeMessage(msg_t *message, msg_manager_t *manager, const pid_t sender);
+int readMessage(msg_t *dest_buffer, msg_manager_t *manager, const pid_t reader, const size_t max_size);
+int peekMessage(msg_manager_t *manager, const pid_t reader, size_t *size);
+bool hasMessage(msg_manager_t *manager, const pid_t reader);
 
 int copy_msg_from_user(msg_t *kmsg, const char *umsg, const ssize_t _size);
 int copy_msg_to_user(const msg_t *kmsg, __user char *ubuffer, const ssize_t _size);
@@ -59,10 +66,17 @@ int copy_msg_to_user(const msg_t *kmsg, __user char *ubuffer, const ssize_t _siz
 void queueGarbageCollector(struct work_struct *work);
 
 
+//Group references, defined in 'group_manager.c'
+bool getGroup(group_data *grp_data);
+void putGroup(group_data *grp_data);
+
+
 #ifndef DISABLE_DELAYED_MSG
+    int initDelayedQueue(void);
+    void releaseDelayedQueue(void);
     bool isDelaySet(const msg_manager_t *manager);
-    void delayedMessageCallback(struct timer_list *timer);
-    int queueDelayedMessage(msg_t *message, msg_manager_t *manager);
+    void delayedMessageCallback(struct work_struct *work);
+    int queueDelayedMessage(msg_t *message, msg_manager_t *manager, const pid_t sender);
     int revokeDelayedMessage(msg_manager_t *manager);
     int cancelDelay(msg_manager_t *manager);
 #endif
@@ -0,0 +1,509 @@
+#include "stats.h"
+
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/uaccess.h>
+#include <linux/moduleparam.h>
+
+
+static struct dentry *stats_root;     /**< Module's debugfs directory, it contains a directory for each group*/
+
+
+DEFINE_STATIC_KEY_FALSE(lock_stats_key);
+
+static bool lock_stats;     /**< Value of the 'lock_stats' module parameter*/
+
+static const char *lock_names[GROUP_LOCKS] = {
+    [LOCK_QUEUE] = "queue_lock",
+    [LOCK_CONFIG] = "config_lock",
+    [LOCK_MEMBER] = "member_lock",
+    [LOCK_RECIPIENT] = "recipient_lock",
+    [LOCK_DELAYED] = "delayed_lock",
+};
+
+
+/**
+ * @brief Set the 'lock_stats' parameter and switch the static key accordingly
+ * 
+ * @note Locks acquired while the key changes are not accounted, so the 
+ *      counters never see a release without its acquisition
+ */
+static int sSetLockStats(const char *val, const struct kernel_param *kp){
+    bool enabled;
+
+    if(kstrtobool(val, &enabled) < 0)
+        return -EINVAL;
+
+    if(enabled)
+        static_branch_enable(&lock_stats_key);
+    else
+        static_branch_disable(&lock_stats_key);
+
+    lock_stats = enabled;
+
+    return 0;
+}
+
+static const struct kernel_param_ops lock_stats_ops = {
+    .set = sSetLockStats,
+    .get = param_get_bool,
+};
+
+module_param_cb(lock_stats, &lock_stats_ops, &lock_stats, 0644);
+MODULE_PARM_DESC(lock_stats, "Account wait and hold times of the group locks (default: off)");
+
+
+/**
+ * @brief Raise a 64-bit high-water mark that is not protected by any lock
+ */
+static inline void sAtomic64Peak(atomic64_t *peak, const s64 value){
+    s64 old = atomic64_read(peak);
+
+    while(value > old && !atomic64_try_cmpxchg(peak, &old, value))
+        ;
+}
+
+/**
+ * @brief Account the acquisition of a group lock, see 'statsLock'
+ * @param[in] grp_data  Pointer to the main structure of a group
+ * @param[in] lock_id   The acquired lock
+ * @param[in] contended true if the lock was not free at the first attempt
+ * @param[in] start     Time of the first attempt, used only if contended
+ * 
+ * @return The acquisition time
+ */
+u64 statsLockAcquired(group_data *grp_data, const int lock_id, const bool contended, const u64 start){
+    u64 now = ktime_get_ns();
+    u64 wait;
+
+    this_cpu_inc(grp_data->stats.locks->lock[lock_id].acquired);
+
+    if(contended){
+        wait = now - start;
+
+        this_cpu_inc(grp_data->stats.locks->lock[lock_id].contended);
+        this_cpu_add(grp_data->stats.locks->lock[lock_id].wait_ns, wait);
+        sAtomic64Peak(&grp_data->stats.max_wait_ns[lock_id], wait);
+    }
+
+    return now;
+}
+
+/**
+ * @brief Account the hold time of a group lock
+ * @param[in] grp_data  Pointer to the main structure of a group
+ * @param[in] lock_id   The released lock
+ * @param[in] since     Acquisition time returned by 'statsLockAcquired'
+ * 
+ * @return nothing
+ */
+void statsLockReleased(group_data *grp_data, const int lock_id, const u64 since){
+    u64 hold = ktime_get_ns() - since;
+
+    this_cpu_add(grp_data->stats.locks->lock[lock_id].hold_ns, hold);
+    sAtomic64Peak(&grp_data->stats.max_hold_ns[lock_id], hold);
+}
+
+
+/**
+ * @brief Create the module's debugfs directory
+ *
+ * @retval 0 on success
+ *
+ * @note debugfs is optional: if it cannot be created the group directories
+ *      are simply not created, statistics are still available through sysfs
+ */
+int initStatsRoot(void){
+    stats_root = debugfs_create_dir(STATS_DEBUGFS_ROOT, NULL);
+
+    if(IS_ERR(stats_root)){
+        logSysfs("Unable to create the debugfs directory");
+        stats_root = NULL;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Remove the module's debugfs directory
+ *
+ * @note Must be called after all the group directories are removed
+ *
+ * @return nothing
+ */
+void releaseStatsRoot(void){
+    debugfs_remove_recursive(stats_root);
+    stats_root = NULL;
+}
+
+
+/**
+ * @brief Allocate the statistics of a group
+ * @param[in] grp_data Pointer to the main structure of a group
+ *
+ * @retval 0 on success
+ * @retval -ENOMEM if the per-CPU counters cannot be allocated
+ */
+int initGroupStats(group_data *grp_data){
+    group_stats_t *stats = &grp_data->stats;
+    int i;
+
+    stats->counters = alloc_percpu(group_counters_t);
+    stats->delivery_latency = alloc_percpu(latency_hist_t);
+    stats->release_latency = alloc_percpu(latency_hist_t);
+    stats->locks = alloc_percpu(group_lock_stats_t);
+
+    if(!stats->counters || !stats->delivery_latency || !stats->release_latency || !stats->locks){
+        releaseGroupStats(grp_data);
+        return -ENOMEM;
+    }
+
+    stats->peak_queue_depth = 0;
+    stats->peak_storage_size = 0;
+    atomic_set(&stats->peak_members, 0);
+    stats->debugfs_dir = NULL;
+
+    for(i = 0; i < GROUP_LOCKS; i++){
+        atomic64_set(&stats->max_wait_ns[i], 0);
+        atomic64_set(&stats->max_hold_ns[i], 0);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Free the statistics of a group
+ * @param[in] grp_data Pointer to the main structure of a group
+ *
+ * @note Must be called when nothing can update the counters, i.e. when the
+ *      group structure is released
+ *
+ * @return nothing
+ */
+void releaseGroupStats(group_data *grp_data){
+    free_percpu(grp_data->stats.counters);
+    free_percpu(grp_data->stats.delivery_latency);
+    free_percpu(grp_data->stats.release_latency);
+    free_percpu(grp_data->stats.locks);
+
+    grp_data->stats.counters = NULL;
+    grp_data->stats.locks = NULL;
+    grp_data->stats.delivery_latency = NULL;
+    grp_data->stats.release_latency = NULL;
+}
+
+
+/**
+ * @brief Sum the per-CPU counters of a group
+ * @param[in]  grp_data Pointer to the main structure of a group
+ * @param[out] total    Where the sum is written
+ *
+ * @note Counters are read without locks, so the sum is not an atomic snapshot
+ *
+ * @return nothing
+ */
+void sumGroupCounters(group_data *grp_data, group_counters_t *total){
+    group_counters_t *cpu_counters;
+    int cpu;
+
+    memset(total, 0, sizeof(group_counters_t));
+
+    for_each_possible_cpu(cpu){
+        cpu_counters = per_cpu_ptr(grp_data->stats.counters, cpu);
+
+        total->msg_written += READ_ONCE(cpu_counters->msg_written);
+        total->bytes_written += READ_ONCE(cpu_counters->bytes_written);
+        total->msg_read += READ_ONCE(cpu_counters->msg_read);
+        total->bytes_read += READ_ONCE(cpu_counters->bytes_read);
+        total->msg_rejected += READ_ONCE(cpu_counters->msg_rejected);
+        total->bytes_rejected += READ_ONCE(cpu_counters->bytes_rejected);
+        total->msg_delayed += READ_ONCE(cpu_counters->msg_delayed);
+        total->bytes_delayed += READ_ONCE(cpu_counters->bytes_delayed);
+        total->msg_revoked += READ_ONCE(cpu_counters->msg_revoked);
+        total->bytes_revoked += READ_ONCE(cpu_counters->bytes_revoked);
+        total->msg_reclaimed += READ_ONCE(cpu_counters->msg_reclaimed);
+        total->bytes_reclaimed += READ_ONCE(cpu_counters->bytes_reclaimed);
+    }
+}
+
+/**
+ * @brief Write the statistics of a group as "name value" lines
+ * @param[in]  grp_data Pointer to the main structure of a group
+ * @param[out] buf      Destination buffer
+ * @param[in]  size     Size of the destination buffer
+ *
+ * @return The number of characters written
+ */
+int printGroupStats(group_data *grp_data, char *buf, const size_t size){
+    msg_manager_t *manager = grp_data->msg_manager;
+    group_stats_t *stats = &grp_data->stats;
+    group_counters_t total;
+    u_long storage_size;
+    int len = 0;
+    int cpu, i;
+
+    sumGroupCounters(grp_data, &total);
+
+    down_read(&manager->config_lock);
+        storage_size = manager->curr_storage_size;
+    up_read(&manager->config_lock);
+
+    len += scnprintf(buf + len, size - len, "msg_written %llu\nbytes_written %llu\n", total.msg_written, total.bytes_written);
+    len += scnprintf(buf + len, size - len, "msg_read %llu\nbytes_read %llu\n", total.msg_read, total.bytes_read);
+    len += scnprintf(buf + len, size - len, "msg_rejected %llu\nbytes_rejected %llu\n", total.msg_rejected, total.bytes_rejected);
+    len += scnprintf(buf + len, size - len, "msg_delayed %llu\nbytes_delayed %llu\n", total.msg_delayed, total.bytes_delayed);
+    len += scnprintf(buf + len, size - len, "msg_revoked %llu\nbytes_revoked %llu\n", total.msg_revoked, total.bytes_revoked);
+    len += scnprintf(buf + len, size - len, "msg_reclaimed %llu\nbytes_reclaimed %llu\n", total.msg_reclaimed, total.bytes_reclaimed);
+
+    len += scnprintf(buf + len, size - len, "queue_depth %lu\npeak_queue_depth %lu\n",
+                        READ_ONCE(manager->queue_depth), READ_ONCE(stats->peak_queue_depth));
+    len += scnprintf(buf + len, size - len, "storage_size %lu\npeak_storage_size %lu\n",
+                        storage_size, READ_ONCE(stats->peak_storage_size));
+    len += scnprintf(buf + len, size - len, "members %d\npeak_members %d\n",
+                        atomic_read(&grp_data->members_count), atomic_read(&stats->peak_members));
+
+    #ifndef DISABLE_DELAYED_MSG
+        len += scnprintf(buf + len, size - len, "delayed_depth %lu\n", READ_ONCE(manager->delayed_depth));
+    #endif
+
+    //Lock contention, all zero unless the 'lock_stats' parameter was enabled
+    for(i = 0; i < GROUP_LOCKS; i++){
+        u64 acquired = 0, contended = 0, wait_ns = 0, hold_ns = 0;
+
+        for_each_possible_cpu(cpu){
+            acquired += READ_ONCE(per_cpu_ptr(stats->locks, cpu)->lock[i].acquired);
+            contended += READ_ONCE(per_cpu_ptr(stats->locks, cpu)->lock[i].contended);
+            wait_ns += READ_ONCE(per_cpu_ptr(stats->locks, cpu)->lock[i].wait_ns);
+            hold_ns += READ_ONCE(per_cpu_ptr(stats->locks, cpu)->lock[i].hold_ns);
+        }
+
+        len += scnprintf(buf + len, size - len, "%s acquired=%llu contended=%llu wait_ns=%llu max_wait_ns=%lld hold_ns=%llu max_hold_ns=%lld\n",
+                            lock_names[i], acquired, contended, wait_ns, atomic64_read(&stats->max_wait_ns[i]),
+                            hold_ns, atomic64_read(&stats->max_hold_ns[i]));
+    }
+
+    return len;
+}
+
+
+/**
+ * @brief Fill a snapshot with the configuration and the statistics of a group
+ * @param[in]  grp_data Pointer to the main structure of a group
+ * @param[out] snapshot The snapshot to fill, 'size' is left untouched
+ *
+ * @note Each value is consistent on its own, but the snapshot is not atomic
+ *
+ * @return nothing
+ */
+void fillGroupSnapshot(group_data *grp_data, group_snapshot_t *snapshot){
+    msg_manager_t *manager = grp_data->msg_manager;
+    group_stats_t *stats = &grp_data->stats;
+
+    snapshot->version = GROUP_SNAPSHOT_VERSION;
+
+    down_read(&manager->config_lock);
+        snapshot->max_message_size = manager->max_message_size;
+        snapshot->max_storage_size = manager->max_storage_size;
+        snapshot->current_storage_size = manager->curr_storage_size;
+    up_read(&manager->config_lock);
+
+    #ifndef DISABLE_DELAYED_MSG
+        snapshot->message_delay = atomic_long_read(&manager->message_delay);
+        snapshot->delayed_depth = READ_ONCE(manager->delayed_depth);
+    #else
+        snapshot->message_delay = 0;
+        snapshot->delayed_depth = 0;
+    #endif
+
+    #ifndef DISABLE_THREAD_BARRIER
+        snapshot->barrier_parties = atomic_read(&grp_data->barrier.counters->parties);
+    #else
+        snapshot->barrier_parties = 0;
+    #endif
+
+    snapshot->garbage_collector_ratio = atomic_read(&grp_data->garbage_collector.ratio);
+
+    down_read(&grp_data->owner_lock);
+        snapshot->owner = grp_data->owner;
+    up_read(&grp_data->owner_lock);
+
+    snapshot->strict_mode = grp_data->flags.strict_mode;
+    snapshot->garbage_collector_disabled = grp_data->flags.garbage_collector_disabled;
+    snapshot->include_struct_size = grp_data->flags.gc_include_struct;
+    snapshot->reserved = 0;
+
+    snapshot->queue_depth = READ_ONCE(manager->queue_depth);
+    snapshot->peak_queue_depth = READ_ONCE(stats->peak_queue_depth);
+    snapshot->peak_storage_size = READ_ONCE(stats->peak_storage_size);
+    snapshot->members = atomic_read(&grp_data->members_count);
+    snapshot->peak_members = atomic_read(&stats->peak_members);
+
+    sumGroupCounters(grp_data, &snapshot->counters);
+}
+
+/**
+ * @brief Copy a snapshot of a group to user space
+ * @param[in]     grp_data      Pointer to the main structure of a group
+ * @param[in,out] user_snapshot User-space snapshot, its 'size' field must be set
+ *
+ * @retval 0 on success
+ * @retval -EFAULT if the user-space structure cannot be accessed
+ * @retval -EINVAL if the provided size cannot hold the header of the structure
+ */
+int copyGroupSnapshot(group_data *grp_data, group_snapshot_t __user *user_snapshot){
+    group_snapshot_t snapshot;
+    u32 size;
+
+    if(get_user(size, &user_snapshot->size))
+        return -EFAULT;
+
+    if(size < offsetofend(group_snapshot_t, size))
+        return -EINVAL;
+
+    fillGroupSnapshot(grp_data, &snapshot);
+    snapshot.size = min_t(u32, size, sizeof(group_snapshot_t));
+
+    if(copy_to_user(user_snapshot, &snapshot, snapshot.size))
+        return -EFAULT;
+
+    return 0;
+}
+
+
+/**
+ * @brief Show callback of the debugfs 'stats' file
+ * 
+ * @note The name is required by 'DEFINE_SHOW_ATTRIBUTE'
+ */
+static int sStats_show(struct seq_file *m, void *v){
+    char *buf;
+
+    buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+    if(!buf)
+        return -ENOMEM;
+
+    printGroupStats(m->private, buf, PAGE_SIZE);
+    seq_puts(m, buf);
+
+    kfree(buf);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sStats);
+
+
+/**
+ * @brief Print a per-CPU histogram as "<lower bound in us> <count>" lines
+ */
+static void sPrintHistogram(struct seq_file *m, const char *name, latency_hist_t __percpu *hist){
+    u64 buckets[LATENCY_BUCKETS] = {0};
+    u64 samples = 0;
+    int cpu, i;
+
+    for_each_possible_cpu(cpu){
+        for(i = 0; i < LATENCY_BUCKETS; i++)
+            buckets[i] += READ_ONCE(per_cpu_ptr(hist, cpu)->buckets[i]);
+    }
+
+    for(i = 0; i < LATENCY_BUCKETS; i++)
+        samples += buckets[i];
+
+    seq_printf(m, "%s samples=%llu\n", name, samples);
+
+    for(i = 0; i < LATENCY_BUCKETS; i++)
+        seq_printf(m, "%llu %llu\n", i == 0 ? 0ULL : 1ULL << (i - 1), buckets[i]);
+}
+
+/**
+ * @brief Reset all the buckets of a per-CPU histogram
+ * 
+ * @note Samples recorded concurrently on other CPUs may survive the reset
+ */
+static void sResetHistogram(latency_hist_t __percpu *hist){
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(hist, cpu), 0, sizeof(latency_hist_t));
+}
+
+/**
+ * @brief Show callback of the debugfs 'latency' file
+ */
+static int sLatencyShow(struct seq_file *m, void *v){
+    group_data *grp_data = m->private;
+
+    sPrintHistogram(m, "delivery_latency_us", grp_data->stats.delivery_latency);
+    sPrintHistogram(m, "release_latency_us", grp_data->stats.release_latency);
+
+    return 0;
+}
+
+static int sLatencyOpen(struct inode *inode, struct file *file){
+    return single_open(file, sLatencyShow, inode->i_private);
+}
+
+/**
+ * @brief Any write on the debugfs 'latency' file resets both histograms
+ */
+static ssize_t sLatencyWrite(struct file *file, const char __user *buf, size_t count, loff_t *ppos){
+    group_data *grp_data = ((struct seq_file*)file->private_data)->private;
+
+    sResetHistogram(grp_data->stats.delivery_latency);
+    sResetHistogram(grp_data->stats.release_latency);
+
+    return count;
+}
+
+static const struct file_operations latency_fops = {
+    .owner = THIS_MODULE,
+    .open = sLatencyOpen,
+    .read = seq_read,
+    .write = sLatencyWrite,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+
+/**
+ * @brief Create the debugfs directory of a group
+ * @param[in] grp_data Pointer to the main structure of a group
+ *
+ * The directory is called 'group<ID>' and is placed inside the module's directory.
+ *
+ * @note In case the directory cannot be created, no error is returned
+ *
+ * @return nothing
+ */
+void registerGroupDebugfs(group_data *grp_data){
+    char dir_name[DEVICE_NAME_SIZE];
+    struct dentry *dir;
+
+    if(!stats_root)
+        return;
+
+    snprintf(dir_name, DEVICE_NAME_SIZE, "group%d", grp_data->group_id);
+
+    dir = debugfs_create_dir(dir_name, stats_root);
+    if(IS_ERR(dir)){
+        logSysfs("Unable to create the debugfs directory of group %d", grp_data->group_id);
+        return;
+    }
+
+    debugfs_create_file("stats", S_IRUGO, dir, grp_data, &sStats_fops);
+    debugfs_create_file("latency", S_IRUGO | S_IWUSR, dir, grp_data, &latency_fops);
+
+    grp_data->stats.debugfs_dir = dir;
+}
+
+/**
+ * @brief Remove the debugfs directory of a group
+ * @param[in] grp_data Pointer to the main structure of a group
+ *
+ * @note Waits for the readers of its files, after that the files can no longer
+ *      reference the group
+ *
+ * @return nothing
+ */
+void unregisterGroupDebugfs(group_data *grp_data){
+    debugfs_remove_recursive(grp_data->stats.debugfs_dir);
+    grp_data->stats.debugfs_dir = NULL;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file stats.h
+ * @brief Per-group runtime statistics, exposed through sysfs and debugfs
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/bitops.h>
+#include <linux/jump_label.h>
+#include <linux/rwsem.h>
+#include <linux/semaphore.h>
+
+#include "types.h"
+#include "log.h"
+
+
+#define STATS_DEBUGFS_ROOT  "thread_synch"      /**< Name of the module's debugfs directory*/
+
+
+/**
+ * @brief Add 'count' messages of 'size' total bytes to a counter pair of a group
+ *
+ * @note Safe from any context, only the current CPU's counters are touched
+ */
+#define statsAddN(grp_data, name, count, size)                              \
+    do{                                                                     \
+        this_cpu_add((grp_data)->stats.counters->msg_##name, (count));      \
+        this_cpu_add((grp_data)->stats.counters->bytes_##name, (size));     \
+    }while(0)
+
+/** @brief Add a message of 'size' bytes to a counter pair of a group*/
+#define statsAdd(grp_data, name, size)  statsAddN(grp_data, name, 1, size)
+
+/**
+ * @brief Record in a per-CPU histogram the time elapsed since 'start'
+ */
+static inline void statsLatency(latency_hist_t __percpu *hist, const ktime_t start){
+    u64 elapsed = ktime_to_us(ktime_sub(ktime_get(), start));
+
+    this_cpu_inc(hist->buckets[min_t(unsigned int, fls64(elapsed), LATENCY_BUCKETS - 1)]);
+}
+
+DECLARE_STATIC_KEY_FALSE(lock_stats_key);
+
+u64 statsLockAcquired(group_data *grp_data, const int lock_id, const bool contended, const u64 start);
+void statsLockReleased(group_data *grp_data, const int lock_id, const u64 since);
+
+/**
+ * @brief Acquire a group lock, accounting the acquisition if lock statistics are enabled
+ * 
+ * The lock is first tried without waiting: only when this fails the wait is timed.
+ * 
+ * @return The acquisition time, to be passed to the matching release, or 0 if 
+ *      the acquisition was not accounted
+ */
+#define statsLock(grp_data, lock_id, trylock_expr, lock_expr)                   \
+    ({                                                                          \
+        u64 __since = 0;                                                        \
+        if(static_branch_unlikely(&lock_stats_key)){                            \
+            u64 __start = ktime_get_ns();                                       \
+            bool __contended = !(trylock_expr);                                 \
+            if(__contended)                                                     \
+                lock_expr;                                                      \
+            __since = statsLockAcquired(grp_data, lock_id, __contended, __start); \
+        }else                                                                   \
+            lock_expr;                                                          \
+        __since;                                                                \
+    })
+
+/**
+ * @brief Release a group lock, accounting the hold time if the acquisition was accounted
+ */
+#define statsUnlock(grp_data, lock_id, since, unlock_expr)                      \
+    do{                                                                         \
+        unlock_expr;                                                            \
+        if(since)                                                               \
+            statsLockReleased(grp_data, lock_id, since);                        \
+    }while(0)
+
+/** @brief Account a lock already taken with a trylock, see 'statsLock'*/
+#define statsLockTaken(grp_data, lock_id)                                       \
+    (static_branch_unlikely(&lock_stats_key) ? statsLockAcquired(grp_data, lock_id, false, 0) : 0)
+
+#define statsDownRead(grp_data, lock_id, sem)           statsLock(grp_data, lock_id, down_read_trylock(sem), down_read(sem))
+#define statsDownWrite(grp_data, lock_id, sem)          statsLock(grp_data, lock_id, down_write_trylock(sem), down_write(sem))
+#define statsDown(grp_data, lock_id, sem)               statsLock(grp_data, lock_id, !down_trylock(sem), down(sem))
+
+#define statsUpRead(grp_data, lock_id, sem, since)      statsUnlock(grp_data, lock_id, since, up_read(sem))
+#define statsUpWrite(grp_data, lock_id, sem, since)     statsUnlock(grp_data, lock_id, since, up_write(sem))
+#define statsUp(grp_data, lock_id, sem, since)          statsUnlock(grp_data, lock_id, since, up(sem))
+
+
+/**
+ * @brief Raise a high-water mark, the caller must hold the lock protecting 'value'
+ */
+static inline void statsPeak(u_long *peak, const u_long value){
+    if(value > *peak)
+        WRITE_ONCE(*peak, value);
+}
+
+/**
+ * @brief Raise a high-water mark that is not protected by any lock
+ */
+static inline void statsAtomicPeak(atomic_t *peak, const int value){
+    int old = atomic_read(peak);
+
+    while(value > old && !atomic_try_cmpxchg(peak, &old, value))
+        ;
+}
+
+
+int initStatsRoot(void);
+void releaseStatsRoot(void);
+
+int initGroupStats(group_data *grp_data);
+void releaseGroupStats(group_data *grp_data);
+
+void registerGroupDebugfs(group_data *grp_data);
+void unregisterGroupDebugfs(group_data *grp_data);
+
+void sumGroupCounters(group_data *grp_data, group_counters_t *total);
+int printGroupStats(group_data *grp_data, char *buf, const size_t size);
+void fillGroupSnapshot(group_data *grp_data, group_snapshot_t *snapshot);
+int copyGroupSnapshot(group_data *grp_data, group_snapshot_t __user *user_snapshot);
+
+
+#endif //STATS_H
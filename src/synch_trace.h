@@ -0,0 +1,311 @@
+/**
+ * @file synch_trace.h
+ *
+ * @brief Tracepoints of the message, delayed delivery, garbage collector and
+ *          barrier paths
+ *
+ * Events are exported under the 'thread_synch' system and can be enabled
+ * through ftrace ('/sys/kernel/tracing/events/thread_synch') or perf
+ * ('perf record -e thread_synch:*'). When disabled they cost a patched-out branch.
+ *
+ * Every event reports the group ID and the PID of the thread involved; message
+ * events also report the size and the sequence number assigned by 'writeMessage'.
+ *
+ * @note The tracepoints are instantiated in 'main.c', which defines 'CREATE_TRACE_POINTS'
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM thread_synch
+
+#if !defined(SYNCH_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define SYNCH_TRACE_H
+
+#include <linux/tracepoint.h>
+
+
+/*------------------------------------------------------------------------------
+	Message events
+------------------------------------------------------------------------------*/
+
+DECLARE_EVENT_CLASS(synch_msg_class,
+
+    TP_PROTO(int group_id, size_t size, pid_t pid, u64 sequence),
+
+    TP_ARGS(group_id, size, pid, sequence),
+
+    TP_STRUCT__entry(
+        __field(int, group_id)
+        __field(size_t, size)
+        __field(pid_t, pid)
+        __field(u64, sequence)
+    ),
+
+    TP_fast_assign(
+        __entry->group_id = group_id;
+        __entry->size = size;
+        __entry->pid = pid;
+        __entry->sequence = sequence;
+    ),
+
+    TP_printk("group=%d size=%zu pid=%d seq=%llu",
+        __entry->group_id, __entry->size, __entry->pid, __entry->sequence)
+);
+
+/** @brief A message was added to the FIFO queue, 'pid' is the author*/
+DEFINE_EVENT(synch_msg_class, synch_msg_write_accept,
+    TP_PROTO(int group_id, size_t size, pid_t pid, u64 sequence),
+    TP_ARGS(group_id, size, pid, sequence)
+);
+
+/** @brief A message was delivered to the reader 'pid'*/
+DEFINE_EVENT(synch_msg_class, synch_msg_read_deliver,
+    TP_PROTO(int group_id, size_t size, pid_t pid, u64 sequence),
+    TP_ARGS(group_id, size, pid, sequence)
+);
+
+
+/** @brief A message was rejected, 'error' is the module's error code*/
+TRACE_EVENT(synch_msg_write_reject,
+
+    TP_PROTO(int group_id, size_t size, pid_t pid, int error),
+
+    TP_ARGS(group_id, size, pid, error),
+
+    TP_STRUCT__entry(
+        __field(int, group_id)
+        __field(size_t, size)
+        __field(pid_t, pid)
+        __field(int, error)
+    ),
+
+    TP_fast_assign(
+        __entry->group_id = group_id;
+        __entry->size = size;
+        __entry->pid = pid;
+        __entry->error = error;
+    ),
+
+    TP_printk("group=%d size=%zu pid=%d error=%d",
+        __entry->group_id, __entry->size, __entry->pid, __entry->error)
+);
+
+/** @brief No message was available for the reader 'pid'*/
+TRACE_EVENT(synch_msg_read_miss,
+
+    TP_PROTO(int group_id, pid_t pid, u64 sequence),
+
+    TP_ARGS(group_id, pid, sequence),
+
+    TP_STRUCT__entry(
+        __field(int, group_id)
+        __field(pid_t, pid)
+        __field(u64, sequence)
+    ),
+
+    TP_fast_assign(
+        __entry->group_id = group_id;
+        __entry->pid = pid;
+        __entry->sequence = sequence;
+    ),
+
+    TP_printk("group=%d pid=%d last_seq=%llu",
+        __entry->group_id, __entry->pid, __entry->sequence)
+);
+
+
+/*------------------------------------------------------------------------------
+	Delayed delivery events
+------------------------------------------------------------------------------*/
+
+/** @brief A message was put in the delayed queue for 'delay' seconds*/
+TRACE_EVENT(synch_delayed_queue,
+
+    TP_PROTO(int group_id, size_t size, pid_t pid, long delay),
+
+    TP_ARGS(group_id, size, pid, delay),
+
+    TP_STRUCT__entry(
+        __field(int, group_id)
+        __field(size_t, size)
+        __field(pid_t, pid)
+        __field(long, delay)
+    ),
+
+    TP_fast_assign(
+        __entry->group_id = group_id;
+        __entry->size = size;
+        __entry->pid = pid;
+        __entry->delay = delay;
+    ),
+
+    TP_printk("group=%d size=%zu pid=%d delay=%ld",
+        __entry->group_id, __entry->size, __entry->pid, __entry->delay)
+);
+
+/** @brief The delay of a message elapsed, 'ret' is the result of 'writeMessage'*/
+TRACE_EVENT(synch_delayed_release,
+
+    TP_PROTO(int group_id, size_t size, pid_t pid, int ret),
+
+    TP_ARGS(group_id, size, pid, ret),
+
+    TP_STRUCT__entry(
+        __field(int, group_id)
+        __field(size_t, size)
+        __field(pid_t, pid)
+        __field(int, ret)
+    ),
+
+    TP_fast_assign(
+        __entry->group_id = group_id;
+        __entry->size = size;
+        __entry->pid = pid;
+        __entry->ret = ret;
+    ),
+
+    TP_printk("group=%d size=%zu pid=%d ret=%d",
+        __entry->group_id, __entry->size, __entry->pid, __entry->ret)
+);
+
+
+/*------------------------------------------------------------------------------
+	Garbage collector events
+------------------------------------------------------------------------------*/
+
+/** @brief The garbage collector started on a group*/
+TRACE_EVENT(synch_gc_start,
+
+    TP_PROTO(int group_id, u_long storage_size),
+
+    TP_ARGS(group_id, storage_size),
+
+    TP_STRUCT__entry(
+        __field(int, group_id)
+        __field(u_long, storage_size)
+    ),
+
+    TP_fast_assign(
+        __entry->group_id = group_id;
+        __entry->storage_size = storage_size;
+    ),
+
+    TP_printk("group=%d storage=%lu", __entry->group_id, __entry->storage_size)
+);
+
+/** @brief The garbage collector ended, 'skipped' is set if the queue was busy*/
+TRACE_EVENT(synch_gc_end,
+
+    TP_PROTO(int group_id, unsigned int entries, unsigned int recipients, u_long bytes, bool skipped),
+
+    TP_ARGS(group_id, entries, recipients, bytes, skipped),
+
+    TP_STRUCT__entry(
+        __field(int, group_id)
+        __field(unsigned int, entries)
+        __field(unsigned int, recipients)
+        __field(u_long, bytes)
+        __field(bool, skipped)
+    ),
+
+    TP_fast_assign(
+        __entry->group_id = group_id;
+        __entry->entries = entries;
+        __entry->recipients = recipients;
+        __entry->bytes = bytes;
+        __entry->skipped = skipped;
+    ),
+
+    TP_printk("group=%d entries=%u recipients=%u bytes=%lu skipped=%d",
+        __entry->group_id, __entry->entries, __entry->recipients,
+        __entry->bytes, __entry->skipped)
+);
+
+
+/*------------------------------------------------------------------------------
+	Barrier events
+------------------------------------------------------------------------------*/
+
+/** @brief Thread 'pid' went to sleep on 'generation'*/
+TRACE_EVENT(synch_barrier_sleep,
+
+    TP_PROTO(int group_id, pid_t pid, u32 generation),
+
+    TP_ARGS(group_id, pid, generation),
+
+    TP_STRUCT__entry(
+        __field(int, group_id)
+        __field(pid_t, pid)
+        __field(u32, generation)
+    ),
+
+    TP_fast_assign(
+        __entry->group_id = group_id;
+        __entry->pid = pid;
+        __entry->generation = generation;
+    ),
+
+    TP_printk("group=%d pid=%d gen=%u",
+        __entry->group_id, __entry->pid, __entry->generation)
+);
+
+/** @brief Thread 'pid' left the barrier, 'ret' is the value returned by the sleep*/
+TRACE_EVENT(synch_barrier_leave,
+
+    TP_PROTO(int group_id, pid_t pid, u32 generation, int ret),
+
+    TP_ARGS(group_id, pid, generation, ret),
+
+    TP_STRUCT__entry(
+        __field(int, group_id)
+        __field(pid_t, pid)
+        __field(u32, generation)
+        __field(int, ret)
+    ),
+
+    TP_fast_assign(
+        __entry->group_id = group_id;
+        __entry->pid = pid;
+        __entry->generation = generation;
+        __entry->ret = ret;
+    ),
+
+    TP_printk("group=%d pid=%d gen=%u ret=%d",
+        __entry->group_id, __entry->pid, __entry->generation, __entry->ret)
+);
+
+/** @brief Thread 'pid' woke up the sleepers of the generation preceding 'generation'*/
+TRACE_EVENT(synch_barrier_wake,
+
+    TP_PROTO(int group_id, pid_t pid, u32 generation, int sleepers),
+
+    TP_ARGS(group_id, pid, generation, sleepers),
+
+    TP_STRUCT__entry(
+        __field(int, group_id)
+        __field(pid_t, pid)
+        __field(u32, generation)
+        __field(int, sleepers)
+    ),
+
+    TP_fast_assign(
+        __entry->group_id = group_id;
+        __entry->pid = pid;
+        __entry->generation = generation;
+        __entry->sleepers = sleepers;
+    ),
+
+    TP_printk("group=%d pid=%d gen=%u sleepers=%d",
+        __entry->group_id, __entry->pid, __entry->generation, __entry->sleepers)
+);
+
+
+#endif  //SYNCH_TRACE_H
+
+
+/* This part must be outside the include guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE synch_trace
+
+#include <trace/define_trace.h>
@@ -24,8 +24,8 @@ bool hasStorePrivilege(group_data *grp_data){
 
                 current_owner = grp_data->owner;
 
-                pr_debug("Current owner: %d", current_owner);
-                pr_debug("Current thread: %d", current_uid().val );
+                logSysfs("Current owner: %d", current_owner);
+                logSysfs("Current thread: %d", current_uid().val );
 
                 if(current_uid().val == current_owner){
                         ret = true;
@@ -68,11 +68,11 @@ static ssize_t max_msg_size_show(struct kobject *kobj, struct kobj_attribute *at
                 return -1;
         }
 
-        pr_debug("Locking config");
+        logSysfs("Locking config");
         down_read(&manager->config_lock);
                 max_msg_size = manager->max_message_size;
         up_read(&manager->config_lock);
-        pr_debug("Unlocking config");
+        logSysfs("Unlocking config");
 
         
         return snprintf(user_buff, ATTR_BUFF_SIZE,"%ld", max_msg_size);
@@ -115,7 +115,7 @@ static ssize_t max_msg_size_store(struct kobject *kobj, struct kobj_attribute *a
         ret = sscanf(user_buf, "%ld", &tmp);
 
         if(ret < 0){
-                pr_debug("Conversion error, exiting...");
+                logSysfs("Conversion error, exiting...");
                 return -1;
         }
 
@@ -123,7 +123,7 @@ static ssize_t max_msg_size_store(struct kobject *kobj, struct kobj_attribute *a
                 manager->max_message_size = tmp;
         up_write(&manager->config_lock);
 
-        pr_debug("Value of 'max_msg_size' set to %ld", manager->max_message_size);
+        logSysfs("Value of 'max_msg_size' set to %ld", manager->max_message_size);
 
         return ret;
 }
@@ -197,7 +197,7 @@ static ssize_t max_storage_size_store(struct kobject *kobj, struct kobj_attribut
         ret = sscanf(user_buf, "%ld", &tmp);
 
         if(ret < 0){
-                pr_debug("Conversion error, exiting...");
+                logSysfs("Conversion error, exiting...");
                 return -1;
         }
 
@@ -205,7 +205,7 @@ static ssize_t max_storage_size_store(struct kobject *kobj, struct kobj_attribut
                 manager->max_storage_size = tmp;
         up_write(&manager->config_lock);
 
-        pr_debug("Value of 'max_storage_size' set to %ld", manager->max_storage_size);
+        logSysfs("Value of 'max_storage_size' set to %ld", manager->max_storage_size);
 
         return 0;
 }
@@ -359,7 +359,7 @@ static ssize_t garbage_collector_enabled_store(struct kobject *kobj, struct kobj
         ret = sscanf(user_buf, "%d", &tmp);
 
         if(ret < 0){
-                pr_debug("Conversion error, exiting...");
+                logSysfs("Conversion error, exiting...");
                 return -1;
         }
 
@@ -370,7 +370,7 @@ static ssize_t garbage_collector_enabled_store(struct kobject *kobj, struct kobj
         else
                 return -1;
         
-        pr_debug("Garbage collector flag set to: %d", grp_data->flags.garbage_collector_disabled);
+        logSysfs("Garbage collector flag set to: %d", grp_data->flags.garbage_collector_disabled);
 
         return 0;
 }
@@ -440,13 +440,13 @@ static ssize_t garbage_collector_ratio_store(struct kobject *kobj, struct kobj_a
         ret = sscanf(user_buf, "%d", &tmp);
 
         if(ret < 0){
-                pr_debug("Conversion error, exiting...");
+                logSysfs("Conversion error, exiting...");
                 return -1;
         }
 
         atomic_set(&grp_data->garbage_collector.ratio, tmp);
         
-        pr_debug("Garbage collector ratio set to: %d", tmp);
+        logSysfs("Garbage collector ratio set to: %d", tmp);
 
         return 0;
 }
@@ -464,7 +464,7 @@ static ssize_t include_struct_size_show(struct kobject *kobj, struct kobj_attrib
         group_sysfs_t *group_sysfs;
         bool enabled;
 
-        group_sysfs = container_of(attr, group_sysfs_t, attr_current_storage_size);
+        group_sysfs = container_of(attr, group_sysfs_t, attr_include_struct_size);
         grp_data = container_of(group_sysfs, group_data, group_sysfs);
         
         if(!grp_data){
@@ -511,18 +511,18 @@ static ssize_t include_struct_size_store(struct kobject *kobj, struct kobj_attri
         ret = sscanf(user_buf, "%d", &tmp);
 
         if(ret < 0){
-                pr_debug("Conversion error, exiting...");
+                logSysfs("Conversion error, exiting...");
                 return -1;
         }
 
         if(tmp > 0)
-                grp_data->flags.gc_include_struct = 0;
-        else if(tmp == 0)
                 grp_data->flags.gc_include_struct = 1;
+        else if(tmp == 0)
+                grp_data->flags.gc_include_struct = 0;
         else
                 return -1;
         
-        pr_debug("Structure message size flag set to: %d", grp_data->flags.garbage_collector_disabled);
+        logSysfs("Structure message size flag set to: %d", grp_data->flags.garbage_collector_disabled);
 
         return 0;
 }
@@ -530,6 +530,76 @@ static ssize_t include_struct_size_store(struct kobject *kobj, struct kobj_attri
 
 
 
+#ifndef DISABLE_THREAD_BARRIER
+/**
+ * @brief Return the number of parties of the counted barrier
+ * @param[out] buffer The buffer where the string containing the value is written
+ * 
+ * @return The number of element written
+ */
+static ssize_t barrier_parties_show(struct kobject *kobj, struct kobj_attribute *attr, char *user_buff){
+        group_data *grp_data;
+        group_sysfs_t *group_sysfs;
+        unsigned int parties;
+
+        group_sysfs = container_of(attr, group_sysfs_t, attr_barrier_parties);
+        grp_data = container_of(group_sysfs, group_data, group_sysfs);
+
+        parties = atomic_read(&grp_data->barrier.counters->parties);
+
+        return snprintf(user_buff, ATTR_BUFF_SIZE, "%u", parties);
+}
+
+/**
+ * @brief Set the number of parties of the counted barrier
+ * @param[in] buffer The buffer containing the new value, 0 disables the counted barrier
+ * 
+ * @return The number of bytes consumed, negative number on error
+ */
+static ssize_t barrier_parties_store(struct kobject *kobj, struct kobj_attribute *attr, const char *user_buf, size_t count){
+        group_data *grp_data;
+        group_sysfs_t *group_sysfs;
+        unsigned int tmp;
+
+        group_sysfs = container_of(attr, group_sysfs_t, attr_barrier_parties);
+        grp_data = container_of(group_sysfs, group_data, group_sysfs);
+
+        if(!hasStorePrivilege(grp_data)){
+                pr_err("Unable to change parameter: unauthorized");
+                return -EPERM;
+        }
+
+        if(kstrtouint(user_buf, 10, &tmp) < 0){
+                logSysfs("Conversion error, exiting...");
+                return -EINVAL;
+        }
+
+        setBarrierParties(grp_data, tmp);
+
+        logSysfs("Barrier parties set to: %u", tmp);
+
+        return count;
+}
+#endif
+
+
+/**
+ * @brief Return the runtime statistics of the group, one "name value" pair per line
+ * @param[out] buffer The buffer where the statistics are written
+ * 
+ * @return The number of element written
+ */
+static ssize_t stats_show(struct kobject *kobj, struct kobj_attribute *attr, char *user_buff){
+        group_data *grp_data;
+        group_sysfs_t *group_sysfs;
+
+        group_sysfs = container_of(attr, group_sysfs_t, attr_stats);
+        grp_data = container_of(group_sysfs, group_data, group_sysfs);
+
+        return printGroupStats(grp_data, user_buff, PAGE_SIZE);
+}
+
+
 /**
  * @brief Initialize sysfs attributes
  * @param[in] grp_data Pointer to the main structure of a group
@@ -603,7 +673,18 @@ int initSysFs(group_data *grp_data){
         sysfs->attr_include_struct_size.attr.mode =  S_IWUGO | S_IRUGO;
         sysfs->attr_include_struct_size.show = include_struct_size_show;
         sysfs->attr_include_struct_size.store = include_struct_size_store;
-;
+
+        #ifndef DISABLE_THREAD_BARRIER
+                sysfs->attr_barrier_parties.attr.name = "barrier_parties";
+                sysfs->attr_barrier_parties.attr.mode = S_IWUGO | S_IRUGO;
+                sysfs->attr_barrier_parties.show = barrier_parties_show;
+                sysfs->attr_barrier_parties.store = barrier_parties_store;
+        #endif
+
+        sysfs->attr_stats.attr.name = "stats";
+        sysfs->attr_stats.attr.mode = S_IRUGO;
+        sysfs->attr_stats.show = stats_show;
+
 
         if(sysfs_create_file(sysfs->group_kobject, &sysfs->attr_max_message_size.attr) < 0)
                 printk(KERN_WARNING "Unable to create 'max_message_size' attribute");
@@ -621,6 +702,12 @@ int initSysFs(group_data *grp_data){
                 printk(KERN_WARNING "Unable to create 'garbage_collector_enabled' attribute");        
         if(sysfs_create_file(sysfs->group_kobject, &sysfs->attr_include_struct_size.attr) < 0)
                 printk(KERN_WARNING "Unable to create 'include_struct_size' attribute");        
+        #ifndef DISABLE_THREAD_BARRIER
+                if(sysfs_create_file(sysfs->group_kobject, &sysfs->attr_barrier_parties.attr) < 0)
+                        printk(KERN_WARNING "Unable to create 'barrier_parties' attribute");
+        #endif
+        if(sysfs_create_file(sysfs->group_kobject, &sysfs->attr_stats.attr) < 0)
+                printk(KERN_WARNING "Unable to create 'stats' attribute");
 
 
 
@@ -643,9 +730,13 @@ void releaseSysFs(group_sysfs_t *sysfs){
     sysfs_remove_file(sysfs->group_kobject, &sysfs->attr_garbage_collector_enabled.attr);
     sysfs_remove_file(sysfs->group_kobject, &sysfs->attr_garbage_collector_ratio.attr);
     sysfs_remove_file(sysfs->group_kobject, &sysfs->attr_include_struct_size.attr);
+    #ifndef DISABLE_THREAD_BARRIER
+        sysfs_remove_file(sysfs->group_kobject, &sysfs->attr_barrier_parties.attr);
+    #endif
+    sysfs_remove_file(sysfs->group_kobject, &sysfs->attr_stats.attr);
 
 
     kobject_put(sysfs->group_kobject);
 
-    pr_debug("syfs released");
+    logSysfs("syfs released");
 }
\ No newline at end of file
@@ -18,6 +18,8 @@
 #include <linux/cred.h>    //For current_uid()
 
 #include "types.h"
+#include "stats.h"
+#include "log.h"
 
 
 
@@ -38,6 +40,10 @@ static ssize_t garbage_collector_ratio_store(struct kobject *kobj, struct kobj_a
 int initSysFs(group_data *grp_data);
 void releaseSysFs(group_sysfs_t *sysfs);
 
+#ifndef DISABLE_THREAD_BARRIER
+    int setBarrierParties(group_data *grp_data, const unsigned int parties);    //Defined in 'group_manager.c'
+#endif
+
 
 
 
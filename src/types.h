@@ -15,6 +15,10 @@
 #include <linux/rwsem.h>
 #include <linux/workqueue.h>
 #include <linux/cdev.h>
+#include <linux/rhashtable.h>
+#include <linux/kref.h>
+#include <linux/rcupdate.h>
+#include <linux/ktime.h>
 
 
 #ifndef DISABLE_DELAYED_MSG
@@ -24,6 +28,8 @@
 #ifndef DISABLE_THREAD_BARRIER
     #include <linux/wait.h>     //For wait-queue
     #include <linux/sched.h>
+    #include <linux/sched/signal.h>     //For signal_pending()
+    #include <linux/eventfd.h>
 #endif
 
 
@@ -35,8 +41,6 @@
 typedef struct t_message_manager msg_manager_t;
 typedef struct t_message msg_t;
 
-#define DEBUG   //TODO: to remove
-
 /**
  * @brief Basic structure to represent a message
  */
@@ -47,12 +51,37 @@ typedef struct t_message{
 } msg_t;
 
 
+/**
+ * @brief Argument of the batched read and write ioctls
+ * 
+ * 'messages' is a user-space array whose 'buffer' fields point to user memory
+ */
+typedef struct t_msg_batch{
+    msg_t __user *messages;     /**< Messages to write, or buffers to fill*/
+    size_t count;               /**< Number of elements of 'messages'*/
+} msg_batch_t;
+
+
 /** @brief Threads that are members of the group device */
 typedef struct t_group_members{
-    pid_t pid;
+    pid_t pid;                  /**< PID of the member, or negative key of a shared handle*/
     struct list_head list;
 } group_members_t;
 
+/**
+ * @brief State of an open file of a group device, stored in 'file->private_data'
+ * 
+ * By default the member is the thread that opened the file and messages are
+ * delivered to the calling thread. Once the file becomes a shared handle 
+ * (see 'IOCTL_SHARE_HANDLE') the member belongs to the open file instead, so 
+ * every thread using it reads and writes on behalf of the same member.
+ */
+typedef struct t_group_file{
+    struct group_data *group;   /**< Group of the device, referenced until the file is released*/
+    pid_t member;               /**< Key of the entry added to 'active_members'*/
+    bool shared;                /**< true if the member belongs to the file instead of the thread*/
+} group_file_t;
+
 /**
  * @brief Contains a 'msg_t' structure and the relative delivery info
  * 
@@ -61,6 +90,9 @@ typedef struct t_group_members{
  */
 struct t_message_deliver{
     msg_t message;                          /**< The message to deliver */
+    pid_t sender;                           /**< Member key of the author, see 'fileMember'*/
+    u64 sequence;                           /**< Position of the message in the group's queue, starting from 1*/
+    ktime_t timestamp;                      /**< Time when the message was added to the queue*/
 
     struct list_head recipient;             /**< PIDs of threads that have read 'message' */
     struct rw_semaphore recipient_lock;     /**< Recipient list semaphore*/
@@ -70,21 +102,110 @@ struct t_message_deliver{
 
 #ifndef DISABLE_DELAYED_MSG
     /**
-     * @brief Contains a 'msg_t' structure and the timer needed to delay the delivery
+     * @brief Contains a 'msg_t' structure and the work needed to delay the delivery
+     * 
+     * While queued, the structure holds a reference on the group owning 'manager'
      * 
      * @todo Remove the 'manager' field and retrieve it at runtime (saves 8 bytes of mem.)
      */
     struct t_message_delayed_deliver{
         msg_t message;                      /**< The message to deliver*/
+        pid_t sender;                       /**< Member key of the author, see 'fileMember'*/
 
         msg_manager_t *manager;             /**< Pointer to the group's message manager struct */
+        ktime_t timestamp;                  /**< Time when the message was delayed*/
 
-        struct timer_list delayed_timer;    /**< The timer used to delay the delivery*/
+        struct delayed_work delayed_work;   /**< The work that delivers the message when the delay expires*/
         struct list_head delayed_list;  
     };
 
 #endif
 
+#ifndef DISABLE_THREAD_BARRIER
+
+    #define BARRIER_GENERATION(state)       ((u32)((u64)(state) >> 32))     /**< Generation of a barrier state word*/
+    #define BARRIER_ARRIVED(state)          ((u32)(state))                  /**< Arrived threads of a barrier state word*/
+    #define BARRIER_STATE(gen, arrived)     ((s64)(((u64)(gen) << 32) | (u32)(arrived)))
+
+    #define BARRIER_PAGES_ORDER         1   /**< The barrier's state page followed by its counters page*/
+    #define BARRIER_STATE_PGOFF         0   /**< Mapping offset (in pages) of 'barrier_shared_t'*/
+    #define BARRIER_COUNTERS_PGOFF      1   /**< Mapping offset (in pages) of 'barrier_counters_t'*/
+
+    /**
+     * @brief Barrier state shared with user space
+     * 
+     * The structure lives at the start of a page that can be mapped writable by
+     * group members, so that user space can check, arrive on and advance the 
+     * barrier without syscalls, entering the kernel only to sleep or to wake up
+     * real sleepers (see 'IOCTL_BARRIER_WAIT' and 'IOCTL_BARRIER_WAKE').
+     * 
+     * The generation and the number of threads arrived in it share the same
+     * 64-bit word, so that both are updated with a single compare-and-swap.
+     */
+    typedef struct t_barrier_shared{
+        atomic64_t state;           /**< Generation in the upper 32 bits, arrived threads in the lower 32*/
+    } barrier_shared_t;
+
+    /**
+     * @brief Barrier values owned by the kernel
+     * 
+     * They live in the page following 'barrier_shared_t', which user space can
+     * only map read-only: members read them to skip syscalls, but cannot
+     * change them.
+     */
+    typedef struct t_barrier_counters{
+        atomic_t parties;           /**< Number of threads that release a counted barrier, 0 if unset*/
+        atomic_t sleepers;          /**< Threads sleeping in the kernel*/
+        atomic_t watchers;          /**< Eventfds registered on the barrier*/
+    } barrier_counters_t;
+
+    /**
+     * @brief An eventfd signalled every time the barrier's generation advances
+     * 
+     * The registration belongs to the group file it was made through and is
+     * removed when that file is released.
+     */
+    typedef struct t_barrier_eventfd{
+        struct eventfd_ctx *ctx;            /**< The registered eventfd*/
+        struct file *owner;                 /**< Group file used for the registration*/
+        struct list_head list;
+    } barrier_eventfd_t;
+
+    /**
+     * @brief Thread barrier of a group
+     * 
+     * A sleeping thread records the current generation and waits until it
+     * changes, every awake advances it by one. Partial awakes release the 
+     * oldest sleepers without changing the generation. Threads that went to 
+     * sleep before an awake are always released by it, while threads arriving
+     * later wait for the next one, so the barrier can be reused without resetting it.
+     * 
+     * When the number of parties is set, the barrier can also be used as a 
+     * counted barrier: arriving threads sleep until 'parties' threads have 
+     * arrived in the same generation, then the last one advances it.
+     */
+    typedef struct t_thread_barrier{
+        wait_queue_head_t queue;            /**< Queue where processes which slept on the barrier are put*/
+        barrier_shared_t *shared;           /**< Page holding the state of the barrier, writable by members*/
+        barrier_counters_t *counters;       /**< Page after 'shared', read-only for members*/
+
+        struct list_head eventfds;          /**< Registered 'barrier_eventfd_t'*/
+        spinlock_t eventfd_lock;            /**< Lock of the 'eventfds' list*/
+    } thread_barrier_t;
+
+    /**
+     * @brief Wait queue entry of a thread sleeping on the barrier
+     * 
+     * Sleepers are exclusive waiters, 'released' is set under the wait queue
+     * lock when the thread is selected by a wake-up.
+     */
+    typedef struct t_barrier_waiter{
+        struct wait_queue_entry entry;
+        u32 generation;                     /**< Generation the thread is sleeping on*/
+        bool released;
+    } barrier_waiter_t;
+#endif
+
 #ifndef DISABLE_SYSFS
     /**
      * @brief Contains all the 'sysfs' attrubutes and the group's kobject
@@ -100,6 +221,8 @@ struct t_message_deliver{
         struct kobj_attribute attr_garbage_collector_enabled;
         struct kobj_attribute attr_garbage_collector_ratio;
         struct kobj_attribute attr_include_struct_size;
+        struct kobj_attribute attr_barrier_parties;
+        struct kobj_attribute attr_stats;
     }group_sysfs_t;
 
 #endif
@@ -123,10 +246,16 @@ typedef struct t_message_manager{
     struct list_head queue;                 /**< The messages FIFO queue */
     struct rw_semaphore queue_lock;         /**< FIFO queue semaphore */
 
+    struct group_data *group;               /**< Group which owns the message manager*/
+    atomic64_t sequence;                    /**< Sequence number of the last message written*/
+    u_long queue_depth;                     /**< Messages in the FIFO queue, protected by 'queue_lock'*/
+    wait_queue_head_t read_wait;            /**< Files polled for new messages*/
+
     #ifndef DISABLE_DELAYED_MSG
         atomic_long_t message_delay;        /**< Specifies the current delay applied to the group*/
         struct list_head delayed_queue;     /**< The delayed messages queue*/
         struct semaphore delayed_lock;      /**< Semaphore to manage access to the 'delayed_queue'*/
+        u_long delayed_depth;               /**< Messages in the delayed queue, protected by 'delayed_lock'*/
     #endif
 
 } msg_manager_t;
@@ -142,6 +271,24 @@ typedef struct group_t {
 } group_t;
 
 
+/**
+ * @brief Initial configuration of a group
+ * 
+ * Size fields set to 0 are replaced with the default values. The same 
+ * parameters can be changed later through the sysfs interface and ioctls.
+ */
+typedef struct group_config_t {
+    u_long max_message_size;            /**< Group's max message size, 0 for 'DEFAULT_MSG_SIZE'*/
+    u_long max_storage_size;            /**< Max group storage size, 0 for 'DEFAULT_STORAGE_SIZE'*/
+    int garbage_collector_ratio;        /**< Garbage collector ratio, in the range [0, 10]*/
+    bool garbage_collector_disabled;    /**< true to disable the garbage collector*/
+    bool include_struct_size;           /**< true to include supporting structures in the storage size*/
+    bool strict_mode;                   /**< true to enable the strict security mode*/
+    long message_delay;                 /**< Delay applied to the group's messages*/
+    unsigned int barrier_parties;       /**< Parties of the counted barrier, 0 to leave it unset*/
+} group_config_t;
+
+
 /**
  * @brief Contains the various flags that represent the status of the module
  * 
@@ -151,7 +298,6 @@ typedef struct group_t {
  * 
  *  - initialized: indicates that a group has loaded all of its structures
  *  - thread_barrier_loaded: indicate that the 'thread barrier' submodule is initialized
- *  - wake_up_flag: to implement
  *  - sysfs_loaded: indicate that the 'sysfs' interface is initialized
  *  - garbage_collector_disabled: specifies the status of the garbage collector
  *  - sysfs_loaded: indicate that the 'sysfs' interface is initialized
@@ -164,7 +310,6 @@ typedef struct group_flags_t{
 
     #ifndef DISABLE_THREAD_BARRIER
         unsigned int thread_barrier_loaded:1;   /**< 1 if the 'thread_barrier' submodule is initialized*/
-        unsigned int wake_up_flag:1;            /**< Flag used to wake-up all thread which slept on barrier*/
     #endif
 
     #ifndef DISABLE_SYSFS
@@ -198,6 +343,131 @@ typedef struct t_garbage_collector{
 
 
 
+/**
+ * @brief Message counters of a group
+ * 
+ * Each CPU updates its own copy without locks, readers sum all the copies.
+ * 'rejected' counts the attempts refused for the size limits, so a write 
+ * retried after the garbage collector may be counted twice.
+ */
+typedef struct t_group_counters{
+    u64 msg_written;                /**< Messages added to the FIFO queue*/
+    u64 bytes_written;
+    u64 msg_read;                   /**< Messages delivered to a reader*/
+    u64 bytes_read;
+    u64 msg_rejected;               /**< Messages refused for the size limits*/
+    u64 bytes_rejected;
+    u64 msg_delayed;                /**< Messages put in the delayed queue*/
+    u64 bytes_delayed;
+    u64 msg_revoked;                /**< Delayed messages revoked*/
+    u64 bytes_revoked;
+    u64 msg_reclaimed;              /**< Messages freed by the garbage collector*/
+    u64 bytes_reclaimed;
+} group_counters_t;
+
+/**
+ * @brief Group locks whose contention is accounted, see 'group_lock_stats_t'
+ */
+enum group_lock_id {
+    LOCK_QUEUE,                     /**< 'queue_lock' of the message manager*/
+    LOCK_CONFIG,                    /**< 'config_lock' of the message manager*/
+    LOCK_MEMBER,                    /**< 'member_lock' of the group*/
+    LOCK_RECIPIENT,                 /**< 'recipient_lock' of all the group's messages*/
+    LOCK_DELAYED,                   /**< 'delayed_lock' of the message manager*/
+    GROUP_LOCKS
+};
+
+/**
+ * @brief Per-CPU contention counters of the group locks
+ * 
+ * Times are in nanoseconds. An acquisition is contended when the lock could 
+ * not be taken at the first attempt, only contended acquisitions wait.
+ */
+typedef struct t_group_lock_stats{
+    struct{
+        u64 acquired;
+        u64 contended;
+        u64 wait_ns;
+        u64 hold_ns;
+    } lock[GROUP_LOCKS];
+} group_lock_stats_t;
+
+
+#define GROUP_SNAPSHOT_VERSION  2   /**< Version of 'group_snapshot_t', incremented when fields are appended*/
+
+/**
+ * @brief Configuration and statistics of a group, returned by 'IOCTL_GET_GROUP_STATS'
+ * 
+ * Fields have fixed sizes, so that the layout is the same for 32 and 64-bit
+ * callers. New fields are only appended: the caller sets 'size' to the size of
+ * its structure and the module copies at most that many bytes, setting 'size'
+ * to the number of bytes actually written.
+ */
+typedef struct group_snapshot_t {
+    u32 version;                        /**< [out] Version of the structure filled by the module*/
+    u32 size;                           /**< [in,out] Size of the caller's structure, then bytes written*/
+
+    u64 max_message_size;
+    u64 max_storage_size;
+    u64 current_storage_size;
+    s64 message_delay;                  /**< 0 if delayed messages are disabled*/
+    u32 garbage_collector_ratio;
+    u32 barrier_parties;                /**< 0 if the counted barrier is unset or disabled*/
+    u32 owner;
+    u8 strict_mode;
+    u8 garbage_collector_disabled;
+    u8 include_struct_size;
+    u8 reserved;
+
+    u64 queue_depth;
+    u64 peak_queue_depth;
+    u64 peak_storage_size;
+    u32 members;
+    u32 peak_members;
+
+    group_counters_t counters;          /**< Sum of the per-CPU counters*/
+
+    //Version 2
+    u64 delayed_depth;                  /**< Messages waiting in the delayed queue*/
+} group_snapshot_t;
+
+
+#define LATENCY_BUCKETS     32      /**< Buckets of a latency histogram*/
+
+/**
+ * @brief Latency histogram with log2 buckets
+ * 
+ * Bucket 0 counts latencies below 1us, bucket 'i' latencies in [2^(i-1), 2^i) us.
+ * The last bucket also counts all the greater latencies.
+ */
+typedef struct t_latency_hist{
+    u64 buckets[LATENCY_BUCKETS];
+} latency_hist_t;
+
+/**
+ * @brief Runtime statistics of a group
+ * 
+ * High-water marks are updated only when exceeded, under the lock that 
+ * protects the corresponding value ('queue_lock' and 'config_lock').
+ */
+typedef struct t_group_stats{
+    group_counters_t __percpu *counters;    /**< Per-CPU message counters*/
+    latency_hist_t __percpu *delivery_latency;  /**< Per-CPU time between the write of a message and each read*/
+    latency_hist_t __percpu *release_latency;   /**< Per-CPU time between the write of a delayed message and its release*/
+
+    u_long peak_queue_depth;                /**< Maximum number of messages in the FIFO queue*/
+    u_long peak_storage_size;               /**< Maximum storage size reached*/
+    atomic_t peak_members;                  /**< Maximum number of active members*/
+
+    group_lock_stats_t __percpu *locks;     /**< Per-CPU lock contention, updated only if enabled*/
+    atomic64_t max_wait_ns[GROUP_LOCKS];    /**< Longest wait for each lock*/
+    atomic64_t max_hold_ns[GROUP_LOCKS];    /**< Longest hold of each lock*/
+
+    struct dentry *debugfs_dir;             /**< Group's debugfs directory, NULL if not created*/
+} group_stats_t;
+
+
+
 /**
  * @brief Group device data structure
  * 
@@ -205,12 +475,15 @@ typedef struct t_garbage_collector{
  * 
  */
 typedef struct group_data {
-    struct cdev cdev;           /** @brief Character Device definition  */
     struct device* dev;
-    dev_t deviceID;            
+    dev_t deviceID;             /** @brief Device number, its minor is the group ID */
     int group_id;               /** @brief Unique identifier of a group. Provided by IDR */
 
     group_t  descriptor;        /** @brief System-wide descriptor of a group*/
+    struct rhash_head name_node;    /**< Entry of the main device's name hash table*/
+
+    struct kref refcount;       /**< References held by the IDR and by lookups*/
+    struct rcu_head rcu;        /**< Used to defer deallocation after RCU lookups*/
 
     //Owner
     uid_t owner;                
@@ -219,6 +492,7 @@ typedef struct group_data {
     //Members
     struct list_head active_members;            /**< List of process that opened the group*/    
     atomic_t members_count;                     /**< Number of process that opened the group*/
+    atomic_t handle_keys;                       /**< Keys assigned to shared handles, negated to never match a PID*/
     struct rw_semaphore member_lock;            /**< Lock on the active members list*/
 
     //Message-Subsystem
@@ -227,9 +501,12 @@ typedef struct group_data {
     //Garbage Collector
     garbage_collector_t garbage_collector;      /**< Garbage collector instance*/
 
+    //Statistics
+    group_stats_t stats;                        /**< Runtime statistics of the group*/
+
     #ifndef DISABLE_THREAD_BARRIER
         //Thread-barrier
-        wait_queue_head_t barrier_queue;        /**< Queue where processes which slept on a barrier are put*/
+        thread_barrier_t barrier;               /**< Group's thread barrier*/
     #endif
 
 
@@ -5,6 +5,7 @@
 
 
 #include "../lib/thread_synch.h"
+#include "../lib/msg_pool.h"
 #include "lib/ini.h"
 
 thread_synch_t *main_syncher;
@@ -12,6 +13,40 @@ thread_group_t *curr_group = NULL;
 
 pthread_rwlock_t lock_rw = PTHREAD_RWLOCK_INITIALIZER;
 
+#define READ_POOL_SLOTS 1
+
+static __thread msg_pool_t *read_pool = NULL;
+static __thread unsigned int read_pool_group;
+
+
+/**
+ * @brief Read a message into the thread's pool, discarding it
+ *
+ * The pool is rebuilt when the group changes, and when the next message is
+ * longer than its slots because the maximum message size was raised.
+ */
+static void readIntoPool(thread_group_t *group){
+    msg_t message;
+    int ret = MSG_SIZE_ERROR;
+
+    if(read_pool && read_pool_group == group->group_id)
+        ret = readPooledMessage(group, read_pool, &message);
+
+    if(ret == MSG_SIZE_ERROR){
+        destroyMessagePool(read_pool);
+        read_pool = createMessagePool(group, READ_POOL_SLOTS);
+        read_pool_group = group->group_id;
+
+        if(!read_pool)
+            return;
+
+        ret = readPooledMessage(group, read_pool, &message);
+    }
+
+    if(ret == 0)
+        poolPutBuffer(read_pool, message.buffer);
+}
+
 typedef struct{
     char *group_name;
     char *group_operation;
@@ -47,7 +82,7 @@ static int handler(void* user, const char* section, const char* name, const char
         tmp = installGroup(descriptor, main_syncher);
         if(tmp != NULL){
             pthread_rwlock_wrlock(&lock_rw);
-                free(curr_group);
+                unloadGroup(curr_group);
                 curr_group = tmp;
             pthread_rwlock_unlock(&lock_rw);
         }
@@ -60,7 +95,7 @@ static int handler(void* user, const char* section, const char* name, const char
         tmp = loadGroupFromDescriptor(&descriptor, main_syncher);
         if(tmp != NULL){
             pthread_rwlock_wrlock(&lock_rw);
-                free(curr_group);
+                unloadGroup(curr_group);
                 curr_group = tmp;
             pthread_rwlock_unlock(&lock_rw);
         }
@@ -71,10 +106,15 @@ static int handler(void* user, const char* section, const char* name, const char
         tmp = loadGroupFromID(group_id);
         if(tmp != NULL){
             pthread_rwlock_wrlock(&lock_rw);
-                free(curr_group);
+                unloadGroup(curr_group);
                 curr_group = tmp;
             pthread_rwlock_unlock(&lock_rw);
         }
+    } else if (MATCH("group", "uninstall")) {
+        pthread_rwlock_wrlock(&lock_rw);
+            if(curr_group != NULL && uninstallGroup(curr_group, main_syncher) == 0)
+                curr_group = NULL;
+        pthread_rwlock_unlock(&lock_rw);
     } else if (MATCH("message", "write")) {
         
         buffer = strdup(value);
@@ -91,23 +131,14 @@ static int handler(void* user, const char* section, const char* name, const char
         pthread_rwlock_unlock(&lock_rw);
         free(buffer);
     } else if (MATCH("message", "read")) {
-        len = atoi(value);
-
-        //printf("\n[D]Reading %d", pconfig->len);
-        buffer = (char*)malloc(sizeof(char)*(len+1));
-        if(!buffer)
-            return -1;
-
-
         pthread_rwlock_rdlock(&lock_rw);
             if(openGroup(curr_group) < 0){
                 pthread_rwlock_unlock(&lock_rw);
-                free(buffer);
                 return -1;
             }
-            readMessage(buffer, len, curr_group);
+
+            readIntoPool(curr_group);
         pthread_rwlock_unlock(&lock_rw);
-        free(buffer);
     } else if (MATCH("message", "delay")) {
         if(openGroup(curr_group) < 0)
             return -1;        
@@ -128,12 +159,41 @@ static int handler(void* user, const char* section, const char* name, const char
 
         pconfig->delay_value = atol(value);
         sleepOnBarrier(curr_group);
+    } else if (MATCH("synch", "sleep_timeout")) {
+        if(openGroup(curr_group) < 0)
+            return -1;
+
+        if(sleepOnBarrierTimeout(curr_group, atol(value)) == BARRIER_TIMED_OUT)
+            printf("Barrier sleep timed out\n");
     } else if (MATCH("synch", "awake")) {
         if(openGroup(curr_group) < 0)
             return -1;
 
         pconfig->delay_value = atol(value);
         awakeBarrier(curr_group);
+    } else if (MATCH("synch", "map")) {
+        if(openGroup(curr_group) < 0)
+            return -1;
+
+        if(atoi(value) > 0)
+            mapBarrier(curr_group);
+        else
+            unmapBarrier(curr_group);
+    } else if (MATCH("synch", "awake_n")) {
+        if(openGroup(curr_group) < 0)
+            return -1;
+
+        awakeBarrierN(curr_group, (unsigned int)atoi(value));
+    } else if (MATCH("synch", "parties")) {
+        if(openGroup(curr_group) < 0)
+            return -1;
+
+        setBarrierParties(curr_group, (unsigned int)atoi(value));
+    } else if (MATCH("synch", "arrive")) {
+        if(openGroup(curr_group) < 0)
+            return -1;
+
+        arriveOnBarrier(curr_group);
     } else if (MATCH("config", "max_message_size")) {
         if(openGroup(curr_group) < 0)
             return -1;        
@@ -162,6 +222,16 @@ static int handler(void* user, const char* section, const char* name, const char
         getMaxMessageSize(curr_group);
         getMaxStorageSize(curr_group);
         getCurrentStorageSize(curr_group);
+    } else if (MATCH("config", "stats")) {
+        group_snapshot_t snapshot;
+
+        if(openGroup(curr_group) < 0)
+            return -1;
+
+        if(getGroupStats(curr_group, &snapshot) == 0)
+            printf("[group%d] written: %lu, read: %lu, rejected: %lu, queue depth: %lu, members: %u\n",
+                    curr_group->group_id, (unsigned long)snapshot.counters.msg_written, (unsigned long)snapshot.counters.msg_read,
+                    (unsigned long)snapshot.counters.msg_rejected, (unsigned long)snapshot.queue_depth, snapshot.members);
     } else if (MATCH("security", "strict_mode")) {
         if(openGroup(curr_group) < 0)
             return -1;        
@@ -196,10 +266,17 @@ static int handler(void* user, const char* section, const char* name, const char
 
 int loadConfig(char *config_path, thread_synch_t *main_synch){
     configuration config;
+    int ret;
 
     main_syncher = main_synch;
 
-    if (ini_parse(config_path, handler, &config) < 0) {
+    ret = ini_parse(config_path, handler, &config);
+
+    //The pool belongs to the calling thread, which is done with the config
+    destroyMessagePool(read_pool);
+    read_pool = NULL;
+
+    if (ret < 0) {
         printf("Can't load '%s'\n", config_path);
         return 1;
     }